@@ -1,6 +1,8 @@
+attribute vec2 a_position;
+uniform vec2 v_texScale;
 varying vec2 v_texCoord2D;
 
 void main(void) {
-  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
-  v_texCoord2D = gl_MultiTexCoord0.xy;
+  gl_Position = vec4(a_position,0.0,1.0);
+  v_texCoord2D = (a_position*0.5 + 0.5)*v_texScale;
 }
@@ -1,6 +1,8 @@
+attribute vec2 a_position;
+uniform vec2 v_texScale;
 varying vec4 vertTexcoord;
 
 void main(void) {
-  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
-  vertTexcoord = gl_MultiTexCoord0;
+  gl_Position = vec4(a_position,0.0,1.0);
+  vertTexcoord = vec4((a_position*0.5 + 0.5)*v_texScale,0.0,1.0);
 }
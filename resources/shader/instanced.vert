@@ -0,0 +1,62 @@
+attribute vec3 a_position;
+attribute vec3 a_normal;
+attribute mat4 a_instance;
+attribute float a_identifier;
+
+uniform bool b_outline;
+
+vec4 pack_id(float id) {
+  float r = mod(id,256.0);
+  float g = mod(floor(id/256.0),256.0);
+  float b = mod(floor(id/65536.0),256.0);
+  return vec4(r,g,b,0.0)/255.0;
+}
+
+//Same lighting as fixed-function pipeline uses for light 0 (material is set for both faces)
+vec4 lighting(vec3 normal, vec3 eye_position) {
+  vec3 light;
+  float attenuation = 1.0;
+  if (gl_LightSource[0].position.w != 0.0) {
+    vec3 to_light = gl_LightSource[0].position.xyz - eye_position;
+    float distance = length(to_light);
+    light = to_light/distance;
+    attenuation = 1.0/(gl_LightSource[0].constantAttenuation +
+                       gl_LightSource[0].linearAttenuation*distance +
+                       gl_LightSource[0].quadraticAttenuation*distance*distance);
+  } else {
+    light = normalize(gl_LightSource[0].position.xyz);
+  }
+
+  float diffuse = max(dot(normal,light),0.0);
+  float specular = 0.0;
+  if (diffuse > 0.0) {
+    vec3 half_vector = normalize(light + vec3(0.0,0.0,1.0));
+    specular = pow(max(dot(normal,half_vector),0.0),gl_FrontMaterial.shininess);
+  }
+
+  vec4 color = gl_FrontLightModelProduct.sceneColor +
+    attenuation*(gl_FrontLightProduct[0].ambient +
+                 diffuse*gl_FrontLightProduct[0].diffuse +
+                 specular*gl_FrontLightProduct[0].specular);
+  color.a = gl_FrontMaterial.diffuse.a;
+  return color;
+}
+
+void main(void) {
+  vec4 position = a_instance * vec4(a_position,1.0);
+  gl_Position = gl_ModelViewProjectionMatrix * position;
+  gl_ClipVertex = gl_ModelViewMatrix * position; //Cutsections are user clip planes
+
+  if (b_outline) {
+    gl_FrontColor = pack_id(a_identifier);
+    gl_BackColor = gl_FrontColor;
+  } else {
+    //Copies are only rotated and translated, so upper part of the matrix transforms normals
+    mat3 rotation = mat3(a_instance[0].xyz,a_instance[1].xyz,a_instance[2].xyz);
+    vec3 normal = normalize(gl_NormalMatrix * (rotation * a_normal));
+    vec3 eye_position = (gl_ModelViewMatrix * position).xyz;
+
+    gl_FrontColor = lighting(normal,eye_position);
+    gl_BackColor = lighting(-normal,eye_position);
+  }
+}
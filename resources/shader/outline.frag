@@ -1,4 +1,5 @@
 uniform sampler2D s_Data;
+uniform sampler2D s_Selected;
 varying vec2 v_texCoord2D;
 uniform vec2 v_invScreenSize;
 uniform float f_outlineThickness;
@@ -9,12 +10,12 @@ float unpack_id(vec4 c) {
   return (c.r + c.g*256.0 + c.b*256.0*256.0 + c.a*256.0*256.0*256.0)*255.0;
 }
 
-vec4 outline() {
+vec4 outline(sampler2D s_Buffer) {
   //Get color of nearby points
-  vec4 c00 = texture2D(s_Data, vec2(v_texCoord2D.x-v_invScreenSize.x*f_outlineThickness,v_texCoord2D.y));
-  vec4 c01 = texture2D(s_Data, vec2(v_texCoord2D.x+v_invScreenSize.x*f_outlineThickness,v_texCoord2D.y));
-  vec4 c10 = texture2D(s_Data, vec2(v_texCoord2D.x,v_texCoord2D.y-v_invScreenSize.y*f_outlineThickness));
-  vec4 c11 = texture2D(s_Data, vec2(v_texCoord2D.x,v_texCoord2D.y+v_invScreenSize.y*f_outlineThickness));
+  vec4 c00 = texture2D(s_Buffer, vec2(v_texCoord2D.x-v_invScreenSize.x*f_outlineThickness,v_texCoord2D.y));
+  vec4 c01 = texture2D(s_Buffer, vec2(v_texCoord2D.x+v_invScreenSize.x*f_outlineThickness,v_texCoord2D.y));
+  vec4 c10 = texture2D(s_Buffer, vec2(v_texCoord2D.x,v_texCoord2D.y-v_invScreenSize.y*f_outlineThickness));
+  vec4 c11 = texture2D(s_Buffer, vec2(v_texCoord2D.x,v_texCoord2D.y+v_invScreenSize.y*f_outlineThickness));
 
   //Get values of nearby points
   float v00 = unpack_id(c00);
@@ -43,22 +44,22 @@ vec4 outline() {
   return vec4(contour_color,0.0);
 }
 
-vec4 outline_aa() {
+vec4 outline_aa(sampler2D s_Buffer) {
   //Get color of nearby points
-  vec4 c00 = texture2D(s_Data, vec2(v_texCoord2D.x-v_invScreenSize.x*0.5*f_outlineThickness,v_texCoord2D.y));
-  vec4 c01 = texture2D(s_Data, vec2(v_texCoord2D.x+v_invScreenSize.x*0.5*f_outlineThickness,v_texCoord2D.y));
-  vec4 c10 = texture2D(s_Data, vec2(v_texCoord2D.x,v_texCoord2D.y-v_invScreenSize.y*0.5*f_outlineThickness));
-  vec4 c11 = texture2D(s_Data, vec2(v_texCoord2D.x,v_texCoord2D.y+v_invScreenSize.y*0.5*f_outlineThickness));
+  vec4 c00 = texture2D(s_Buffer, vec2(v_texCoord2D.x-v_invScreenSize.x*0.5*f_outlineThickness,v_texCoord2D.y));
+  vec4 c01 = texture2D(s_Buffer, vec2(v_texCoord2D.x+v_invScreenSize.x*0.5*f_outlineThickness,v_texCoord2D.y));
+  vec4 c10 = texture2D(s_Buffer, vec2(v_texCoord2D.x,v_texCoord2D.y-v_invScreenSize.y*0.5*f_outlineThickness));
+  vec4 c11 = texture2D(s_Buffer, vec2(v_texCoord2D.x,v_texCoord2D.y+v_invScreenSize.y*0.5*f_outlineThickness));
 
-  vec4 d00 = texture2D(s_Data, vec2(v_texCoord2D.x-v_invScreenSize.x*1.0*f_outlineThickness,v_texCoord2D.y));
-  vec4 d01 = texture2D(s_Data, vec2(v_texCoord2D.x+v_invScreenSize.x*1.0*f_outlineThickness,v_texCoord2D.y));
-  vec4 d10 = texture2D(s_Data, vec2(v_texCoord2D.x,v_texCoord2D.y-v_invScreenSize.y*1.0*f_outlineThickness));
-  vec4 d11 = texture2D(s_Data, vec2(v_texCoord2D.x,v_texCoord2D.y+v_invScreenSize.y*1.0*f_outlineThickness));
+  vec4 d00 = texture2D(s_Buffer, vec2(v_texCoord2D.x-v_invScreenSize.x*1.0*f_outlineThickness,v_texCoord2D.y));
+  vec4 d01 = texture2D(s_Buffer, vec2(v_texCoord2D.x+v_invScreenSize.x*1.0*f_outlineThickness,v_texCoord2D.y));
+  vec4 d10 = texture2D(s_Buffer, vec2(v_texCoord2D.x,v_texCoord2D.y-v_invScreenSize.y*1.0*f_outlineThickness));
+  vec4 d11 = texture2D(s_Buffer, vec2(v_texCoord2D.x,v_texCoord2D.y+v_invScreenSize.y*1.0*f_outlineThickness));
   
-  vec4 e00 = texture2D(s_Data, vec2(v_texCoord2D.x-v_invScreenSize.x*1.5*f_outlineThickness,v_texCoord2D.y));
-  vec4 e01 = texture2D(s_Data, vec2(v_texCoord2D.x+v_invScreenSize.x*1.5*f_outlineThickness,v_texCoord2D.y));
-  vec4 e10 = texture2D(s_Data, vec2(v_texCoord2D.x,v_texCoord2D.y-v_invScreenSize.y*1.5*f_outlineThickness));
-  vec4 e11 = texture2D(s_Data, vec2(v_texCoord2D.x,v_texCoord2D.y+v_invScreenSize.y*1.5*f_outlineThickness));
+  vec4 e00 = texture2D(s_Buffer, vec2(v_texCoord2D.x-v_invScreenSize.x*1.5*f_outlineThickness,v_texCoord2D.y));
+  vec4 e01 = texture2D(s_Buffer, vec2(v_texCoord2D.x+v_invScreenSize.x*1.5*f_outlineThickness,v_texCoord2D.y));
+  vec4 e10 = texture2D(s_Buffer, vec2(v_texCoord2D.x,v_texCoord2D.y-v_invScreenSize.y*1.5*f_outlineThickness));
+  vec4 e11 = texture2D(s_Buffer, vec2(v_texCoord2D.x,v_texCoord2D.y+v_invScreenSize.y*1.5*f_outlineThickness));
 
   //Get values of nearby points
   float u00 = unpack_id(c00);
@@ -107,9 +108,16 @@ vec4 outline_aa() {
 }
 
 void main(void) {
-  gl_FragColor = outline();
+  //Outline of selected objects is drawn over all other outlines
+  vec4 c_all = outline(s_Data);
+  vec4 c_selected = outline(s_Selected);
+  if (c_selected.a > 0.0) {
+    gl_FragColor = c_selected;
+  } else {
+    gl_FragColor = c_all;
+  }
   
 //  gl_FragColor = vec4(dx*100.0,dy*100.0,d*100.0,1.0);
 //  gl_FragColor = vec4(c00.a*255.0,c00.a*255.0,c00.a*255.0,1.0);
-//  gl_FragColor = vec4(texture2D(s_Data,v_texCoord2D).xyz,1.0);
+//  gl_FragColor = vec4(texture2D(s_Buffer,v_texCoord2D).xyz,1.0);
 }
@@ -1,47 +1,24 @@
 uniform sampler2D s_Data;
 varying vec2 v_texCoord2D;
-uniform vec2 v_invScreenSize;
-
-const float f_BlurMagnitude = 8.0;
+uniform vec2 v_blurStep; //Distance between two taps in texture coordinates
+uniform bool b_blur;
+uniform float f_opacity;
 
 void main(void) {
-  vec4 result = vec4(0,0,0,0);
-
-  result += texture2D(s_Data, vec2(v_texCoord2D.x - 1.00*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.05;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x - 0.75*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.09;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x - 0.50*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.12;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x - 0.25*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.15;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x + 0.00*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.16;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x + 0.25*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.15;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x + 0.50*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.12;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x + 0.75*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.09;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x + 1.00*f_BlurMagnitude*v_invScreenSize.x, v_texCoord2D.y)) * 0.05;
+  float result = texture2D(s_Data, v_texCoord2D).a;
 
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y - 1.00*f_BlurMagnitude*v_invScreenSize.y)) * 0.05;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y - 0.75*f_BlurMagnitude*v_invScreenSize.y)) * 0.09;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y - 0.50*f_BlurMagnitude*v_invScreenSize.y)) * 0.12;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y - 0.25*f_BlurMagnitude*v_invScreenSize.y)) * 0.15;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y + 0.00*f_BlurMagnitude*v_invScreenSize.y)) * 0.16;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y + 0.25*f_BlurMagnitude*v_invScreenSize.y)) * 0.15;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y + 0.50*f_BlurMagnitude*v_invScreenSize.y)) * 0.12;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y + 0.75*f_BlurMagnitude*v_invScreenSize.y)) * 0.09;
-  result += texture2D(s_Data, vec2(v_texCoord2D.x, v_texCoord2D.y + 1.00*f_BlurMagnitude*v_invScreenSize.y)) * 0.05;
-  
-  result += texture2D(s_Data, vec2(
-    v_texCoord2D.x + 0.50*f_BlurMagnitude*v_invScreenSize.x,
-    v_texCoord2D.y + 0.50*f_BlurMagnitude*v_invScreenSize.y)) * 0.10;
-  result += texture2D(s_Data, vec2(
-    v_texCoord2D.x + 0.50*f_BlurMagnitude*v_invScreenSize.x,
-    v_texCoord2D.y - 0.50*f_BlurMagnitude*v_invScreenSize.y)) * 0.10;
-  result += texture2D(s_Data, vec2(
-    v_texCoord2D.x - 0.50*f_BlurMagnitude*v_invScreenSize.x,
-    v_texCoord2D.y - 0.50*f_BlurMagnitude*v_invScreenSize.y)) * 0.10;
-  result += texture2D(s_Data, vec2(
-    v_texCoord2D.x - 0.50*f_BlurMagnitude*v_invScreenSize.x,
-    v_texCoord2D.y + 0.50*f_BlurMagnitude*v_invScreenSize.y)) * 0.10;
+  //One pass of separable gaussian blur (7 taps on each side, sigma is half of the radius)
+  if (b_blur) {
+    float weight_sum = 1.0;
+    for (int i = 1; i <= 7; i++) {
+      float x = float(i)/7.0;
+      float weight = exp(-2.0*x*x);
+      result += texture2D(s_Data, v_texCoord2D + v_blurStep*float(i)).a * weight;
+      result += texture2D(s_Data, v_texCoord2D - v_blurStep*float(i)).a * weight;
+      weight_sum += 2.0*weight;
+    }
+    result = result / weight_sum;
+  }
 
-  gl_FragColor = vec4(0.0,0.0,0.0,result.a*0.40);
-  
-//  gl_FragColor = result;
-//  gl_FragColor = vec4(texture2D(s_Data,v_texCoord2D).r,0.0,0.0,1.0);
+  gl_FragColor = vec4(0.0,0.0,0.0,result*f_opacity);
 }
@@ -34,6 +34,7 @@
 
 #include "fwe.h"
 #include "fwe_main.h"
+#include "fwe_evds_mesh_scheduler.h"
 
 /// Stores current FWE flags
 int fw_editor_flags = 0;
@@ -111,6 +112,7 @@ void fw_editor_initialize(int flags, int argc, char *argv[]) {
 /// @brief Shutdown and clean up all resources
 ////////////////////////////////////////////////////////////////////////////////
 void fw_editor_deinitialize() {
+	EVDS::MeshJobScheduler::shutdown();
 	delete fw_editor_settings;
 	delete fw_application;
 }
@@ -155,6 +155,28 @@ void PreferencesDialog::createPerfomance() {
 	connect(checkBox, SIGNAL(stateChanged(int)), this, SLOT(setBoolWarn(int)));
 	layout->addRow("Use FXAA (antialiasing):<br>(default: <i>true</i>)", checkBox);
 
+	checkBox = new QCheckBox();
+	checkBox->setObjectName("rendering.use_vbo");
+	checkBox->setChecked(fw_editor_settings->value("rendering.use_vbo").toBool());
+	connect(checkBox, SIGNAL(stateChanged(int)), this, SLOT(setBoolWarn(int)));
+	layout->addRow("Store geometry in video memory (VBO):<br>(default: <i>true</i>)", checkBox);
+
+	spinBox = new QSpinBox();
+	spinBox->setObjectName("rendering.shadow_downsample");
+	spinBox->setRange(1,8);
+	spinBox->setValue(fw_editor_settings->value("rendering.shadow_downsample").toInt());
+	connect(spinBox, SIGNAL(valueChanged(int)), this, SLOT(setIntegerWarn(int)));
+	layout->addRow("Shadow resolution divider (higher is faster):<br>(default: <i>2</i>)", spinBox);
+
+	QDoubleSpinBox* doubleSpinBox = new QDoubleSpinBox();
+	doubleSpinBox->setObjectName("rendering.shadow_blur_radius");
+	doubleSpinBox->setRange(0.0,64.0);
+	doubleSpinBox->setSingleStep(1.0);
+	doubleSpinBox->setSuffix(" pixels");
+	doubleSpinBox->setValue(fw_editor_settings->value("rendering.shadow_blur_radius").toDouble());
+	connect(doubleSpinBox, SIGNAL(valueChanged(double)), this, SLOT(setDouble(double)));
+	layout->addRow("Shadow blur radius:<br>(default: <i>8.0</i> pixels)", doubleSpinBox);
+
 	spinBox = new QSpinBox();
 	spinBox->setObjectName("ui.autosave");
 	spinBox->setRange(5,60*60*12);
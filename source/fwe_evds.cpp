@@ -74,6 +74,7 @@ Editor::Editor(ChildWindow* in_window) : QMainWindow(in_window), activeThreads(0
 	window = in_window;
 	selected = NULL;
 	document = NULL;
+	updateScheduled = false;
 
 	//Create EVDS system. Use flag that lists all children, even uninitialized ones to make sure
 	// tree controls list all objects while they are messed around with.
@@ -160,7 +161,9 @@ Editor::~Editor() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Editor::addActiveThread() {
-	activeThreads.fetchAndAddOrdered(1);
+	activeThreadsLock.lock();
+		activeThreads++;
+	activeThreadsLock.unlock();
 }
 
 
@@ -168,7 +171,10 @@ void Editor::addActiveThread() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Editor::removeActiveThread() {
-	activeThreads.fetchAndAddOrdered(-1);
+	activeThreadsLock.lock();
+		activeThreads--;
+		if (activeThreads == 0) activeThreadsFinished.wakeAll();
+	activeThreadsLock.unlock();
 }
 
 
@@ -176,9 +182,11 @@ void Editor::removeActiveThread() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Editor::waitForThreads() {
-	while (activeThreads > 0) ; //FIXME: sleep somehow
-		//QApplication::processEvents();
-	//}
+	activeThreadsLock.lock();
+		while (activeThreads > 0) {
+			activeThreadsFinished.wait(&activeThreadsLock);
+		}
+	activeThreadsLock.unlock();
 }
 
 
@@ -435,8 +443,11 @@ void Editor::showCutsection() {
 /// @brief Callback when root object was initialized
 ////////////////////////////////////////////////////////////////////////////////
 void Editor::rootInitialized() {
-	root_obj->recursiveUpdateInformation(initializer);
+	QVector<ObjectInformation> information;
+	initializer->getInformation(&information);
+	root_obj->recursiveUpdateInformation(information);
 	updateInformation(true);
+	glscene->invalidateFrame(); //Center of mass indicator may have moved
 	update();
 }
 
@@ -445,8 +456,16 @@ void Editor::rootInitialized() {
 /// @brief Callback from when object was modified
 ////////////////////////////////////////////////////////////////////////////////
 void Editor::setModified(bool informationUpdate) {
+	setModified(NULL,informationUpdate);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Callback from when a single object was modified (its children are unaffected)
+////////////////////////////////////////////////////////////////////////////////
+void Editor::setModified(Object* object, bool informationUpdate) {
 	window->setModified();
-	initializer->updateObject();
+	initializer->updateObject(object);
 	if (informationUpdate) updateInformation(false);
 }
 
@@ -473,43 +492,45 @@ void Editor::updateInformation(bool ready) {
 		if (selected) object = selected;
 
 		QString information = "";
-		QVector3D cm = object->getInformationVector("total_cm");
-		if (!object->isInformationDefined("total_cm")) cm = object->getInformationVector("cm");
+		QVector3D cm = object->getInformationVector(ObjectInformation::TOTAL_CM);
+		if (!object->isInformationDefined(ObjectInformation::TOTAL_CM)) cm = object->getInformationVector(ObjectInformation::CM);
 		information = information + tr("CoM: (%1; %2; %3) m\n")
 			.arg(cm.x(),0,'F',3)
 			.arg(cm.y(),0,'F',3)
 			.arg(cm.z(),0,'F',3);
 
 		information = information + tr("Mass: %2 kg (part: %1 kg)\n")
-			.arg(object->getInformationVariable("mass"))
-			.arg(object->getInformationVariable("total_mass"));
+			.arg(object->getInformationVariable(ObjectInformation::MASS))
+			.arg(object->getInformationVariable(ObjectInformation::TOTAL_MASS));
 
 		if (!selected) {
+			updateTransformations(); //Make sure bounding box is up to date
+			GLC_BoundingBox box = glscene->getBoundingBox();
 			information = information + tr("Dimensions: %1 x %2 x %3 m\n")
-				.arg(glscene->getCollection()->boundingBox().xLength(),0,'G',3)
-				.arg(glscene->getCollection()->boundingBox().yLength(),0,'G',3)
-				.arg(glscene->getCollection()->boundingBox().zLength(),0,'G',3);
+				.arg(box.xLength(),0,'G',3)
+				.arg(box.yLength(),0,'G',3)
+				.arg(box.zLength(),0,'G',3);
 		}
 
-		if (object->getType() == "fuel_tank") {
+		if (object->getTypeID() == Object::TYPE_FUEL_TANK) {
 			information = information + tr("\nFuel mass: %1 kg\n")
-			.arg(object->getInformationVariable("fuel_mass"));
+			.arg(object->getInformationVariable(ObjectInformation::FUEL_MASS));
 			information = information + tr("Fuel volume: %1 m\xB3\n")
-			.arg(object->getInformationVariable("fuel_volume"));
+			.arg(object->getInformationVariable(ObjectInformation::FUEL_VOLUME));
 		}
-		if (object->getType() == "rocket_engine") {
+		if (object->getTypeID() == Object::TYPE_ROCKET_ENGINE) {
 			information = information + tr("\nVacuum parameters:\n");
 			information = information + tr(
 				"Isp: %1 sec\n"
 				"Ve: %2 m/s\n"
 				"Thrust: %3 kN\n"
 				"Mass flow: %4 (O: %5, F: %6) kg/sec\n")
-			.arg(object->getInformationVariable("vacuum.isp"),0,'G',3)
-			.arg(object->getInformationVariable("vacuum.exhaust_velocity"),0,'F',0)
-			.arg(object->getInformationVariable("vacuum.thrust")/1e3,0,'G',5)
-			.arg(object->getInformationVariable("vacuum.mass_flow"),0,'G',3)
-			.arg(object->getInformationVariable("vacuum.oxidizer_flow"),0,'G',3)
-			.arg(object->getInformationVariable("vacuum.fuel_flow"),0,'G',3);
+			.arg(object->getInformationVariable(ObjectInformation::VACUUM_ISP),0,'G',3)
+			.arg(object->getInformationVariable(ObjectInformation::VACUUM_EXHAUST_VELOCITY),0,'F',0)
+			.arg(object->getInformationVariable(ObjectInformation::VACUUM_THRUST)/1e3,0,'G',5)
+			.arg(object->getInformationVariable(ObjectInformation::VACUUM_MASS_FLOW),0,'G',3)
+			.arg(object->getInformationVariable(ObjectInformation::VACUUM_OXIDIZER_FLOW),0,'G',3)
+			.arg(object->getInformationVariable(ObjectInformation::VACUUM_FUEL_FLOW),0,'G',3);
 
 			information = information + tr("\n1 bar parameters:\n");
 			information = information + tr(
@@ -517,26 +538,26 @@ void Editor::updateInformation(bool ready) {
 				"Ve: %2 m/s\n"
 				"Thrust: %3 kN\n"
 				"Mass flow: %4 (O: %5, F: %6) kg/sec\n")
-			.arg(object->getInformationVariable("atmospheric.isp"),0,'G',3)
-			.arg(object->getInformationVariable("atmospheric.exhaust_velocity"),0,'F',0)
-			.arg(object->getInformationVariable("atmospheric.thrust")/1e3,0,'G',5)
-			.arg(object->getInformationVariable("atmospheric.mass_flow"),0,'G',3)
-			.arg(object->getInformationVariable("atmospheric.oxidizer_flow"),0,'G',3)
-			.arg(object->getInformationVariable("atmospheric.fuel_flow"),0,'G',3);
+			.arg(object->getInformationVariable(ObjectInformation::ATMOSPHERIC_ISP),0,'G',3)
+			.arg(object->getInformationVariable(ObjectInformation::ATMOSPHERIC_EXHAUST_VELOCITY),0,'F',0)
+			.arg(object->getInformationVariable(ObjectInformation::ATMOSPHERIC_THRUST)/1e3,0,'G',5)
+			.arg(object->getInformationVariable(ObjectInformation::ATMOSPHERIC_MASS_FLOW),0,'G',3)
+			.arg(object->getInformationVariable(ObjectInformation::ATMOSPHERIC_OXIDIZER_FLOW),0,'G',3)
+			.arg(object->getInformationVariable(ObjectInformation::ATMOSPHERIC_FUEL_FLOW),0,'G',3);
 
 			information = information + tr("\nCombustion:\n");
 			information = information + tr(
 				"O:F ratio: %1\n"
 				"Temperature: %2 K\n"
 				"Pressure: %3 Pa\n")
-			.arg(object->getInformationVariable("combustion.of_ratio"),0,'G',3)
-			.arg(object->getInformationVariable("combustion.temperature"),0,'G',3)
-			.arg(object->getInformationVariable("combustion.pressure"),0,'G',3);
+			.arg(object->getInformationVariable(ObjectInformation::COMBUSTION_OF_RATIO),0,'G',3)
+			.arg(object->getInformationVariable(ObjectInformation::COMBUSTION_TEMPERATURE),0,'G',3)
+			.arg(object->getInformationVariable(ObjectInformation::COMBUSTION_PRESSURE),0,'G',3);
 		}
 
-		QVector3D ix = object->getInformationVector("total_ix");
-		QVector3D iy = object->getInformationVector("total_iy");
-		QVector3D iz = object->getInformationVector("total_iz");
+		QVector3D ix = object->getInformationVector(ObjectInformation::TOTAL_IX);
+		QVector3D iy = object->getInformationVector(ObjectInformation::TOTAL_IY);
+		QVector3D iz = object->getInformationVector(ObjectInformation::TOTAL_IZ);
 		/*information = information + tr(
 			"\nInertia tensor:\n"
 			"(%1; %2; %3) kg m\xB2\n"
@@ -546,9 +567,9 @@ void Editor::updateInformation(bool ready) {
 			.arg(iy.x(),0,'G',3).arg(iy.y(),0,'G',3).arg(iy.z(),0,'G',3)
 			.arg(iz.x(),0,'G',3).arg(iz.y(),0,'G',3).arg(iz.z(),0,'G',3);*/
 
-		QVector3D jx = ix / (EVDS_EPS+object->getInformationVariable("total_mass"));
-		QVector3D jy = iy / (EVDS_EPS+object->getInformationVariable("total_mass"));
-		QVector3D jz = iz / (EVDS_EPS+object->getInformationVariable("total_mass"));
+		QVector3D jx = ix / (EVDS_EPS+object->getInformationVariable(ObjectInformation::TOTAL_MASS));
+		QVector3D jy = iy / (EVDS_EPS+object->getInformationVariable(ObjectInformation::TOTAL_MASS));
+		QVector3D jz = iz / (EVDS_EPS+object->getInformationVariable(ObjectInformation::TOTAL_MASS));
 		information = information + tr(
 			"\nRadius of gyration squared:\n"
 			"(%1; %2; %3) m\xB2\n"
@@ -667,10 +688,73 @@ void Editor::updateObject(Object* object) {
 	if (object) {
 		list_model->updateObject(object);
 	}
+	scheduleUpdate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void Editor::scheduleUpdate() {
+	if (updateScheduled) return;
+	updateScheduled = true;
+	QMetaObject::invokeMethod(this,"doScheduledUpdate",Qt::QueuedConnection);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void Editor::doScheduledUpdate() {
+	updateScheduled = false;
+
+	//Rebuild invalidated modifiers before the frame is drawn
+	modifiers_manager->doUpdateModifiers();
 	glscene->update();
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void Editor::transformationChanged(ObjectRenderer* renderer) {
+	movedRenderers.append(renderer);
+	scheduleUpdate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void Editor::rendererRemoved(ObjectRenderer* renderer) {
+	movedRenderers.removeAll(renderer);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Recalculate transformations of the moved objects top-down.
+///
+/// Called before the frame is drawn, and before anything reads objects instances.
+////////////////////////////////////////////////////////////////////////////////
+void Editor::updateTransformations() {
+	QList<ObjectRenderer*> renderers = movedRenderers;
+	movedRenderers.clear();
+	if (!renderers.isEmpty()) glscene->invalidateGeometry();
+
+	//Update topmost moved objects (this updates their children too)
+	for (int i = 0; i < renderers.count(); i++) {
+		renderers[i]->updateTransformation();
+	}
+	//Objects which were not reached through their parents (hidden children)
+	for (int i = 0; i < renderers.count(); i++) {
+		if (renderers[i]->isPositionDirty()) renderers[i]->calculateTransformation();
+	}
+
+	//Modifier copies are placed relative to the objects
+	modifiers_manager->updatePositions();
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -918,7 +1002,7 @@ bool Editor::loadFile(const QString &fileName) {
 	//Find the "document" object, or create it
 	document = 0;
 	for (int i = 0; i < root_obj->getChildrenCount(); i++) {
-		if (root_obj->getChild(i)->getType() == "metadata") {
+		if (root_obj->getChild(i)->getTypeID() == Object::TYPE_METADATA) {
 			document = root_obj->getChild(i);
 			root_obj->hideChild(i);
 		}
@@ -33,7 +33,8 @@
 #include <QFileInfo>
 #include <QMap>
 #include <QList>
-#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
 #include "evds.h"
 #include "evds_antenna.h"
 #include "evds_train_wheels.h"
@@ -65,6 +66,7 @@ namespace EVDS {
 	class GLView;
 	class Object;
 	class ObjectInitializer;
+	class ObjectRenderer;
 	class ObjectTreeModel;
 	class ObjectModifiersManager;
 	class Editor : public QMainWindow
@@ -80,6 +82,7 @@ namespace EVDS {
 		bool saveFile(const QString &fileName);
 		void updateInterface(bool isInFront);
 		void setModified(bool informationUpdate = true);
+		void setModified(Object* object, bool informationUpdate = true);
 
 		ChildWindow* getWindow() { return window; }
 		GLScene* getGLScene() { return glscene; }
@@ -91,6 +94,16 @@ namespace EVDS {
 
 		void updateInformation(bool ready);
 		void updateObject(Object* object);
+
+		//Object was moved, its transformation must be updated before the next frame
+		void transformationChanged(ObjectRenderer* renderer);
+		//Renderer is destroyed and must not be updated anymore
+		void rendererRemoved(ObjectRenderer* renderer);
+		//Update transformations of all moved objects (and modifier copies) in a single pass
+		void updateTransformations();
+		//Update modifiers and repaint scene on the next pass of event loop (repeated requests are merged)
+		void scheduleUpdate();
+
 		void propertySheetUpdated(QWidget* old_sheet, QWidget* new_sheet);
 		void loadError(const QString& error);
 
@@ -99,7 +112,9 @@ namespace EVDS {
 		QMap<QString,QList<QMap<QString,QString> > > csectionVariables;
 
 	private:
-		QAtomicInt activeThreads;
+		int activeThreads;
+		QMutex activeThreadsLock;
+		QWaitCondition activeThreadsFinished;
 
 	public:
 		void addActiveThread();
@@ -118,6 +133,7 @@ namespace EVDS {
 		void commentsChanged();
 		void cleanupTimer();
 		void rootInitialized();
+		void doScheduledUpdate();
 
 		void showProperties();
 		void showCrossSections();
@@ -167,6 +183,11 @@ namespace EVDS {
 		QDockWidget*		comments_dock;
 		QTextEdit*			comments;
 
+		//Renderers of the moved objects
+		QList<ObjectRenderer*> movedRenderers;
+		//Is update already posted to event loop
+		bool updateScheduled;
+
 		//Main workspace
 		GLScene*			glscene;
 		GLView*				glview;
@@ -38,6 +38,7 @@
 #include <GLC_UserInput>
 #include <GLC_Exception>
 #include <GLC_Context>
+#include <GLC_State>
 #include <GLC_CuttingPlane>
 
 #include <math.h>
@@ -45,11 +46,82 @@
 #include "fwe_evds_object.h"
 #include "fwe_evds_object_renderer.h"
 #include "fwe_evds_glscene.h"
+#include "fwe_evds_instanced_renderer.h"
+#include "fwe_evds_render_target_pool.h"
+#include "fwe_evds_screen_pass.h"
+#include "fwe_evds_sheet_writer.h"
 #include "fwe_schematics.h"
 #include "fwe_schematics_renderer.h"
 
 using namespace EVDS;
 
+#ifndef GL_COLOR_ATTACHMENT1
+#define GL_COLOR_ATTACHMENT1 0x8CE1
+#endif
+#ifndef GL_MAX_DRAW_BUFFERS
+#define GL_MAX_DRAW_BUFFERS 0x8824
+#endif
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Names of variables used for drawing schematics sheets
+////////////////////////////////////////////////////////////////////////////////
+static const VariableName var_sheet_code("sheet.code");
+static const VariableName var_document_code("document.code");
+static const VariableName var_sheet_number("sheet.number");
+static const VariableName var_paper_ppcm("paper.ppcm");
+static const VariableName var_reference("reference");
+static const VariableName var_text("text");
+static const VariableName var_paper_width_multiplier("paper.width_multiplier");
+static const VariableName var_paper_height_multiplier("paper.height_multiplier");
+static const VariableName var_document_created_by("document.created_by");
+static const VariableName var_document_drawn_by("document.drawn_by");
+static const VariableName var_document_verified_by("document.verified_by");
+static const VariableName var_sheet_scale("sheet.scale");
+static const VariableName var_sheet_title("sheet.title");
+static const VariableName var_document_title("document.title");
+static const VariableName var_document_company("document.company");
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check if vertex buffer objects must be used.
+///
+/// Software OpenGL implementations are faster with client-side arrays, so the old
+/// path is kept for them.
+////////////////////////////////////////////////////////////////////////////////
+static bool FWE_GLScene_UseVBO() {
+	if (fw_editor_settings->value("rendering.use_vbo") == false) return false;
+	if (!GLC_State::vboSupported()) return false;
+
+	QString renderer = QString((const char*)glGetString(GL_RENDERER));
+	if (renderer.contains("GDI Generic") ||
+		renderer.contains("llvmpipe") ||
+		renderer.contains("softpipe") ||
+		renderer.contains("Software Rasterizer")) {
+		qWarning("GLScene: software OpenGL (%s), not using VBOs",renderer.toAscii().data());
+		return false;
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Hidden widget, whose context is shared by all views.
+///
+/// Geometry is shared between the editor and schematics views, so its buffers
+/// must be valid in all of their contexts.
+////////////////////////////////////////////////////////////////////////////////
+QGLWidget* GLView::getShareWidget() {
+	static QGLWidget* share_widget = 0;
+	if (!share_widget) {
+		share_widget = new QGLWidget(new GLC_Context(QGLFormat(QGL::SampleBuffers)));
+	}
+	return share_widget;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
@@ -71,7 +143,17 @@ GLScene::GLScene(GLScene* in_parent_scene, Editor* in_editor, SchematicsEditor*
 	fbo_outline = 0;
 	fbo_outline_selected = 0;
 	fbo_shadow = 0;
+	fbo_shadow_blur = 0;
 	fbo_fxaa = 0;
+	shadowDownsample = 1;
+	shadowValid = false;
+	frameValid = false;
+	overlayValid = false;
+	overlaySheet = 0;
+	geometryGeneration = 0;
+	frameGeneration = 0;
+	fbo_outline_attachment = 0;
+	drawBuffers = 0;
 
 	cutsectionPlaneWidget[0] = 0;
 	cutsectionPlaneWidget[1] = 0;
@@ -82,6 +164,7 @@ GLScene::GLScene(GLScene* in_parent_scene, Editor* in_editor, SchematicsEditor*
 	controller = GLC_Factory::instance()->createDefaultMoverController(QColor(255,30,30), viewport);
 	world = new GLC_World();
 	widget_manager = new GLC_3DWidgetManager(viewport);
+	instanced_renderer = new InstancedRenderer();
 
 	//GLC scene cannot be empty, either it crashes. Also ensure minimum size of bounding box
 	GLC_3DViewInstance instance1(GLC_Factory::instance()->createCircle(0.0));
@@ -109,7 +192,7 @@ GLScene::GLScene(GLScene* in_parent_scene, Editor* in_editor, SchematicsEditor*
 	viewport->cameraHandle()->setDefaultUpVector(glc::Z_AXIS);
 	viewport->cameraHandle()->setIsoView();
 	world->collection()->setLodUsage(true,viewport);
-	//world->collection()->setVboUsage(true); FIXME
+	//VBO usage is enabled once OpenGL context is known (see drawBackground)
 	viewport->setMinimumPixelCullingSize(fw_editor_settings->value("rendering.min_pixel_culling").toInt());
 	GLC_SelectionMaterial::setUseSelectionMaterial(false);
 
@@ -121,6 +204,7 @@ GLScene::GLScene(GLScene* in_parent_scene, Editor* in_editor, SchematicsEditor*
 	sceneOrthographic = true;
 	sceneShadowed = false;
 	sceneWireframe = false;
+	sceneUseVBO = false;
 	makingScreenshot = false;
 	if (schematics_editor) viewport->cameraHandle()->setTopView();
 
@@ -134,6 +218,7 @@ GLScene::GLScene(GLScene* in_parent_scene, Editor* in_editor, SchematicsEditor*
 ////////////////////////////////////////////////////////////////////////////////
 GLScene::~GLScene()
 {
+	delete instanced_renderer;
 }
 
 
@@ -235,7 +320,7 @@ void GLScene::createInterface() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void GLScene::doCenter() {
-	viewport->reframe(world->collection()->boundingBox(),1.6);
+	viewport->reframe(getBoundingBox(),1.6);
 }
 void GLScene::toggleProjection() {
 	sceneOrthographic = !sceneOrthographic;
@@ -312,20 +397,22 @@ void GLScene::saveSheets() {
 	int sheet_no = 1;
 	for (int i = 0; i < schematics_editor->getRoot()->getChildrenCount(); i++) {
 		Object* sheet = schematics_editor->getRoot()->getChild(i);
-		if (sheet->getType() == "foxworks.schematics.sheet") {
+		if (sheet->getTypeID() == Object::TYPE_SCHEMATICS_SHEET) {
 			schematics_editor->setCurrentSheet(sheet);
 			schematics_editor->getSchematicsRenderingManager()->updateInstances();
 
-			QString code = sheet->getString("sheet.code");
-			if (code == "") code = editor->getEditDocument()->getString("document.code");
+			QString code = sheet->getString(var_sheet_code);
+			if (code == "") code = editor->getEditDocument()->getString(var_document_code);
 			if (code == "") code = baseInfo.baseName();
-			if (sheet->getVariable("sheet.number") > 0.0) sheet_no = (int)sheet->getVariable("sheet.number");
+			if (sheet->getVariable(var_sheet_number) > 0.0) sheet_no = (int)sheet->getVariable(var_sheet_number);
 
-			saveCurrentSheet(tr("%1 (sheet %2).jpg")
+			if (saveCurrentSheet(tr("%1 (sheet %2).tif")
 				.arg(code)
-				.arg(sheet_no));
-
-			editor->getWindow()->getMainWindow()->statusBar()->showMessage(tr("Exported sheet %1..").arg(sheet_no),2000);
+				.arg(sheet_no))) {
+				editor->getWindow()->getMainWindow()->statusBar()->showMessage(tr("Exported sheet %1..").arg(sheet_no),2000);
+			} else {
+				editor->getWindow()->getMainWindow()->statusBar()->showMessage(tr("Could not export sheet %1!").arg(sheet_no),3000);
+			}
 			sheet_no++;
 		}
 	}
@@ -357,16 +444,33 @@ void GLScene::setBottomView() {
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief
+/// @brief Copy tile out of the pixel buffer (rows are stored bottom-up by OpenGL)
 ////////////////////////////////////////////////////////////////////////////////
-void GLScene::saveCurrentSheet(const QString& baseFilename) {
-	if (!schematics_editor->getCurrentSheet()) return;
+static QImage FWE_ReadPixelBuffer(QGLBuffer* pbo, int width, int height) {
+	QImage image;
+	pbo->bind();
+	const uchar* data = (const uchar*)pbo->map(QGLBuffer::ReadOnly);
+	if (data) {
+		image = QImage(data,width,height,QImage::Format_RGB32).mirrored();
+		pbo->unmap();
+	}
+	pbo->release();
+	return image;
+}
 
-	QGLFramebufferObjectFormat format;
-	format.setSamples(16);
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Render current sheet in tiles and save it as a TIFF image.
+///
+/// Tiles are read back through pixel buffers: while one tile is transferred, the
+/// previous one is copied out and passed to the writer thread, which streams the
+/// rows into the file.
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::saveCurrentSheet(const QString& baseFilename) {
+	if (!schematics_editor->getCurrentSheet()) return false;
 
 	//Get number of pixels per cm
-	float ppcm = schematics_editor->getCurrentSheet()->getVariable("paper.ppcm");
+	float ppcm = schematics_editor->getCurrentSheet()->getVariable(var_paper_ppcm);
 	if (ppcm <= 0.0) ppcm = 32.0;
 
 	//Get paper size
@@ -377,73 +481,99 @@ void GLScene::saveCurrentSheet(const QString& baseFilename) {
 	int width = paper_width*ppcm;
 	int height = paper_height*ppcm;
 
-	//Create final image buffer
-	QImage finalImage(width,height,QImage::Format_RGB32);
+	//Tiles are written into file by a worker thread
+	SheetImageWriter writer(baseFilename,width,height,ppcm);
+	if (!writer.open()) return false;
+
+	//Single framebuffer is used for all tiles
 	int fbo_width = 1024;
 	int fbo_height = 1024;
-	int x = 0;
-	int y = 0;
+	QGLFramebufferObject renderFbo(fbo_width,fbo_height);
+
+	//Two pixel buffers: one receives the current tile while the previous one is read
+	QGLBuffer pbo[2];
+	bool usePBO = true;
+	for (int i = 0; i < 2; i++) {
+		pbo[i] = QGLBuffer(QGLBuffer::PixelPackBuffer);
+		pbo[i].setUsagePattern(QGLBuffer::StreamRead);
+		if (pbo[i].create()) {
+			pbo[i].bind();
+			pbo[i].allocate(fbo_width*fbo_height*4);
+			pbo[i].release();
+		} else {
+			usePBO = false;
+		}
+	}
+	int pending_x = -1;
+	int pending_y = -1;
+	int tile = 0;
 
 	//Save camera
 	GLC_Camera old_camera = GLC_Camera(*viewport->cameraHandle());
-	
-	while (x < width) {
-		y = 0;
-		while (y < height) {
-			//Create FBO and draw into it
-			QGLFramebufferObject renderFbo(fbo_width,fbo_height);
+	QRectF oldRect = sceneRect();
+	setSceneRect(QRectF(0,0,fbo_width,fbo_height));
+	panel_control->hide();
+	panel_view->hide();
+	makingScreenshot = true;
+
+	//Tiles are rendered row by row, so the file is written mostly sequentially
+	for (int y = 0; y < height; y += fbo_height) {
+		for (int x = 0; x < width; x += fbo_width) {
+			//Offsets in meters
+			float xstep = (fbo_width/ppcm)*0.01f;
+			float ystep = (fbo_height/ppcm)*0.01f;
+
+			//Calculate proper camera offset
+			GLC_Vector3d targetVector(
+				xstep*0.5f + xstep*(x/((float)fbo_width)),
+				ystep*0.5f + ystep*((height-y)/((float)fbo_height) - 1),
+				0);
+
+			//Frame image correctly
+			viewport->cameraHandle()->translate(targetVector-viewport->cameraHandle()->target());
+			viewport->cameraHandle()->setDistEyeTarget(ystep*1.430f);
+
+			//Render
 			QPainter fboPainter(&renderFbo);
 			fboPainter.setRenderHint(QPainter::Antialiasing);
 			fboPainter.setRenderHint(QPainter::HighQualityAntialiasing);
-
-				//Offsets in meters
-				float xstep = (fbo_width/ppcm)*0.01f;
-				float ystep = (fbo_height/ppcm)*0.01f;
-
-				//Calculate proper camera offset
-				GLC_Vector3d targetVector(
-					xstep*0.5f + xstep*(x/((float)fbo_width)),
-					ystep*0.5f + ystep*((height-y)/((float)fbo_height) - 1),
-					0);
-
-				//if (width < fbo_width) targetVector.setX(0.0);
-				//if (height < fbo_height) targetVector.setY(0.0);
-
-				//Frame image correctly
-				viewport->cameraHandle()->translate(targetVector-viewport->cameraHandle()->target());
-				viewport->cameraHandle()->setDistEyeTarget(ystep*1.430f);
-
-				//Render
-				QRectF oldRect = sceneRect();
-				setSceneRect(QRectF(0,0,fbo_width,fbo_height));
-				panel_control->hide();
-				panel_view->hide();
-					makingScreenshot = true;
-					render(&fboPainter);
-					//fboPainter.drawText(0,50,tr("POSITION %1x%2").arg(x/2048).arg(0));
-					makingScreenshot = false;
-				setSceneRect(oldRect);
-				panel_control->show();
-				panel_view->show();
-
+			render(&fboPainter);
 			fboPainter.end();
 
-			QPainter painter(&finalImage);
-			painter.drawImage(x, y, renderFbo.toImage());
-			painter.end();
-
-			y += fbo_height;
+			if (usePBO) {
+				//Start transfer of this tile
+				int current = tile % 2;
+				renderFbo.bind();
+				pbo[current].bind();
+				glReadPixels(0,0,fbo_width,fbo_height,GL_BGRA,GL_UNSIGNED_BYTE,0);
+				pbo[current].release();
+				renderFbo.release();
+
+				//Previous tile must be ready by now
+				if (pending_x >= 0) {
+					writer.writeTile(pending_x,pending_y,FWE_ReadPixelBuffer(&pbo[1-current],fbo_width,fbo_height));
+				}
+				pending_x = x;
+				pending_y = y;
+			} else {
+				writer.writeTile(x,y,renderFbo.toImage());
+			}
+			tile++;
 		}
-
-		x += fbo_width;
+	}
+	if (pending_x >= 0) {
+		writer.writeTile(pending_x,pending_y,FWE_ReadPixelBuffer(&pbo[(tile-1) % 2],fbo_width,fbo_height));
 	}
 
 	//Restore camera
+	makingScreenshot = false;
+	setSceneRect(oldRect);
+	panel_control->show();
+	panel_view->show();
 	viewport->cameraHandle()->setCam(old_camera);
 
-	//Save image
-	finalImage.save(baseFilename,0,95);
-	//renderFbo.toImage().save(baseFilename,0,95);
+	for (int i = 0; i < 2; i++) pbo[i].destroy();
+	return writer.finish();
 }
 
 
@@ -459,9 +589,39 @@ void GLScene::cutsectionUpdated() {
 	}*/
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Update instance stored in collection in place.
+///
+/// Setting the matrix recomputes bounding box of the stored instance, collection
+/// entry itself is not removed and re-created.
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::updateInstance(const GLC_3DViewInstance& instance) {
+	GLC_3DViewCollection* collection = world->collection();
+	if (collection->contains(instance.id())) {
+		GLC_3DViewInstance* stored_instance = collection->instanceHandle(instance.id());
+		stored_instance->setMatrix(instance.matrix());
+		stored_instance->setVisibility(instance.isVisible());
+		geometryGeneration++;
+	} else {
+		collection->add(instance);
+		if (sceneUseVBO) collection->instanceHandle(instance.id())->setVboUsage(true);
+		geometryGeneration++;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+GLC_BoundingBox GLScene::getBoundingBox() {
+	GLC_BoundingBox box = world->collection()->boundingBox();
+	if (!instanced_renderer->isEmpty()) box.combine(instanced_renderer->boundingBox());
+	return box;
+}
+
 void GLScene::setCutsectionPlane(int plane, bool active) {
+	geometryGeneration++;
 	if (active) {
-		GLC_Point3d center = world->collection()->boundingBox().center();
+		GLC_Point3d center = getBoundingBox().center();
 		GLC_Vector3d normal(0,1,0);
 		//const double d1 = 1.00 * world->collection()->boundingBox().xLength();
 		//const double d2 = 1.00 * world->collection()->boundingBox().yLength();
@@ -540,24 +700,45 @@ void GLScene::loadShaders() {
 	shader_outline = compileShader("outline");
 	shader_shadow = compileShader("shadow");
 	shader_fxaa = compileShader("fxaa");
+	shader_instanced = compileShader("instanced");
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Draw schematics page layout
+/// @brief Compute matrix which transforms world coordinates into window coordinates.
+///
+/// Must be called after camera is set up. Matrices are taken from GLC, so OpenGL
+/// state is not queried.
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::updateProjection() {
+	QMatrix4x4 projection = QMatrix4x4(GLC_Context::current()->projectionMatrix().getData()).transposed();
+	QMatrix4x4 view = QMatrix4x4(GLC_Context::current()->modelViewMatrix().getData()).transposed();
+
+	//Normalized device coordinates into window coordinates (Y axis points down)
+	QMatrix4x4 window;
+	window.translate(0.5*previousRect.width(),0.5*previousRect.height());
+	window.scale(0.5*previousRect.width(),-0.5*previousRect.height());
+
+	windowMatrix = window*projection*view;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Project point into window coordinates
 ////////////////////////////////////////////////////////////////////////////////
 QPointF GLScene::project(float x, float y, float z) {
-	//Get OpenGL matrices
-	double projectionMatrix[16];
-	double viewMatrix[16];
-	glGetDoublev(GL_PROJECTION_MATRIX, projectionMatrix);
-	glGetDoublev(GL_MODELVIEW_MATRIX, viewMatrix);
-
-	//Create result
-	QPointF result;
-	QVector3D screenPos = QVector3D(x,y,0)*QMatrix4x4(viewMatrix)*QMatrix4x4(projectionMatrix);
-	result.setX(0.5*(screenPos.x()+1.0) * previousRect.width());
-	result.setY(0.5*(1.0-screenPos.y()) * previousRect.height());
+	return windowMatrix.map(QVector3D(x,y,z)).toPointF();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Project points on the XY plane into window coordinates
+////////////////////////////////////////////////////////////////////////////////
+QVector<QPointF> GLScene::project(const QVector<QPointF>& points) {
+	QVector<QPointF> result(points.count());
+	for (int i = 0; i < points.count(); i++) {
+		result[i] = windowMatrix.map(points[i]);
+	}
 	return result;
 }
 
@@ -568,16 +749,16 @@ QPointF GLScene::project(float x, float y, float z) {
 void GLScene::drawSchematicsElement(QPainter *painter, Object* element, QPointF offset) {
 	for (int i = 0; i < element->getChildrenCount(); i++) {
 		Object* child = element->getChild(i);
-		if (child->getType() == "foxworks.schematics.element") {
+		if (child->getTypeID() == Object::TYPE_SCHEMATICS_ELEMENT) {
 			//Get state vector
 			EVDS_STATE_VECTOR vector;
 			EVDS_Object_GetStateVector(child->getEVDSObject(),&vector);
 
 			//Draw if it's a label
-			if (child->getString("reference") == "") {
+			if (child->getString(var_reference) == "") {
 				float font_size = 0.005f; //FIXME
 				QString value = element->getName();
-				if (child->getString("text") != "") value = child->getString("text");
+				if (child->getString(var_text) != "") value = child->getString(var_text);
 				
 				//Fake multi-line text
 				QStringList lines = value.split("\n");
@@ -595,6 +776,47 @@ void GLScene::drawSchematicsElement(QPainter *painter, Object* element, QPointF
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draw schematics page layout and labels.
+///
+/// Page is recorded into a picture and replayed until the sheet is modified or
+/// the camera is zoomed or rotated. In orthographic view panning only moves the
+/// page, so the picture is recorded relative to the sheet origin.
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::drawSchematicsOverlay(QPainter *painter) {
+	Object* sheet = schematics_editor->getCurrentSheet();
+	if (!sheet) return;
+
+	//Screenshots are drawn directly
+	if (makingScreenshot) {
+		drawSchematicsPage(painter);
+		return;
+	}
+
+	//Remove translation from the key, if it does not affect the rest of projection
+	QPointF origin = project(0,0);
+	QMatrix4x4 key = windowMatrix;
+	if ((key(3,0) == 0.0) && (key(3,1) == 0.0) && (key(3,2) == 0.0) && (key(3,3) == 1.0)) {
+		key(0,3) = 0.0;
+		key(1,3) = 0.0;
+	}
+
+	//Record picture again
+	if ((!overlayValid) || (overlaySheet != sheet) || (overlayMatrix != key)) {
+		overlayPicture = QPicture();
+		QPainter picture_painter(&overlayPicture);
+		picture_painter.translate(-origin);
+		drawSchematicsPage(&picture_painter);
+		picture_painter.end();
+
+		overlayValid = true;
+		overlaySheet = sheet;
+		overlayMatrix = key;
+	}
+	painter->drawPicture(origin,overlayPicture);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Draw schematics page layout
 ////////////////////////////////////////////////////////////////////////////////
@@ -637,22 +859,29 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 	int sectionMulW = 1;
 	int sectionMulH = 1;
 
-	double wm = sheet->getVariable("paper.width_multiplier");
-	double hm = sheet->getVariable("paper.height_multiplier");
+	double wm = sheet->getVariable(var_paper_width_multiplier);
+	double hm = sheet->getVariable(var_paper_height_multiplier);
 	if (wm > 1.0) sectionMulW = (int)wm;
 	if (hm > 1.0) sectionMulH = (int)hm;
 
 	float sectionWidth = width / (sectionMulW*10.0f);
 	float sectionHeight = height / (sectionMulH*10.0f);
+	QVector<QPointF> section_lines;
+	for (int x = 1; x < sectionMulW*10; x++) {
+		section_lines << QPointF(sectionWidth*x,0.00f) << QPointF(sectionWidth*x,margin);
+		section_lines << QPointF(sectionWidth*x,height-margin) << QPointF(sectionWidth*x,height);
+	}
+	for (int y = 1; y < sectionMulH*10; y++) {
+		section_lines << QPointF(0.00f,sectionHeight*y) << QPointF(margin,sectionHeight*y);
+		section_lines << QPointF(width-margin,sectionHeight*y) << QPointF(width,sectionHeight*y);
+	}
+	painter->drawLines(project(section_lines));
+
 	for (int x = 1; x < sectionMulW*10; x++) {
-		painter->drawLine(project(sectionWidth*x,0.00f),project(sectionWidth*x,margin));
-		painter->drawLine(project(sectionWidth*x,height-margin),project(sectionWidth*x,height));
 		painter->drawText(project(sectionWidth*(x-0.5f),0.5*(margin-normal_font)),tr("%1").arg(x));
 		painter->drawText(project(sectionWidth*(x-0.5f),height-margin+0.5*(margin-normal_font)),tr("%1").arg(x));
 	}
 	for (int y = 1; y < sectionMulH*10; y++) {
-		painter->drawLine(project(0.00f,sectionHeight*y),project(margin,sectionHeight*y));
-		painter->drawLine(project(width-margin,sectionHeight*y),project(width,sectionHeight*y));
 		painter->drawText(
 			project(
 			0.5*(margin-normal_font_w),
@@ -666,27 +895,28 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 
 	//Draw page information (GOST 2.104)
 	if (1) { //First page
+#define local_point(x,y) QPointF(width-0.185-margin+x,margin+0.040-y)
 #define local(x,y) project(width-0.185-margin+x,margin+0.040-y)
 
 		//General frame
 		painter->drawRect(QRectF(local(0.000,0.000),local(0.185,0.040)));
 
 		//Draw all other lines
-		painter->drawLine(local(0.065,0.000),local(0.065,0.040));
-		painter->drawLine(local(0.065,0.015),local(0.185,0.015));
-		painter->drawLine(local(0.135,0.015),local(0.135,0.040));
+		QVector<QPointF> lines;
+		lines << local_point(0.065,0.000) << local_point(0.065,0.040);
+		lines << local_point(0.065,0.015) << local_point(0.185,0.015);
+		lines << local_point(0.135,0.015) << local_point(0.135,0.040);
 
-		painter->drawLine(local(0.135,0.020),local(0.185,0.020));
-		painter->drawLine(local(0.135,0.025),local(0.185,0.025));
-		painter->drawLine(local(0.150,0.015),local(0.150,0.025));
-		painter->drawLine(local(0.165,0.015),local(0.165,0.025));
+		lines << local_point(0.135,0.020) << local_point(0.185,0.020);
+		lines << local_point(0.135,0.025) << local_point(0.185,0.025);
+		lines << local_point(0.150,0.015) << local_point(0.150,0.025);
+		lines << local_point(0.165,0.015) << local_point(0.165,0.025);
 
-		painter->drawLine(local(0.017,0.000),local(0.017,0.040));
+		lines << local_point(0.017,0.000) << local_point(0.017,0.040);
 		for (int line = 1; line <= 7; line++) {
-			painter->drawLine(local(0.000,0.005*line),local(0.065,0.005*line));
+			lines << local_point(0.000,0.005*line) << local_point(0.065,0.005*line);
 		}
-
-		painter->drawLine(local(0.017,0.000),local(0.017,0.040));
+		painter->drawLines(project(lines));
 
 		//Draw texts
 		painter->setFont(QFont("GOST type B",small_font_px));
@@ -699,11 +929,11 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 			painter->drawText(local(0.170,0.019),"Scale");
 
 			//Fill out fields
-			painter->drawText(local(0.018,0.014),editor->getEditDocument()->getString("document.created_by"));
-			painter->drawText(local(0.018,0.019),editor->getEditDocument()->getString("document.drawn_by"));
-			painter->drawText(local(0.018,0.024),editor->getEditDocument()->getString("document.verified_by"));
+			painter->drawText(local(0.018,0.014),editor->getEditDocument()->getString(var_document_created_by));
+			painter->drawText(local(0.018,0.019),editor->getEditDocument()->getString(var_document_drawn_by));
+			painter->drawText(local(0.018,0.024),editor->getEditDocument()->getString(var_document_verified_by));
 
-			double scale = sheet->getVariable("sheet.scale");
+			double scale = sheet->getVariable(var_sheet_scale);
 			if (scale <= 0.0) scale = 1.0;
 			painter->drawText(local(0.170,0.024),"1:" + tr("%1").arg(scale));
 		painter->setFont(QFont("GOST type B",normal_font_px));
@@ -713,25 +943,25 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 		QString value;
 
 
-		if (sheet->getString("sheet.code") != "") {
-			value = sheet->getString("sheet.code");
+		if (sheet->getString(var_sheet_code) != "") {
+			value = sheet->getString(var_sheet_code);
 		} else {
-			value = editor->getEditDocument()->getString("document.code");
+			value = editor->getEditDocument()->getString(var_document_code);
 		}
 		painter->drawText(local(0.065 + 0.5*(0.185-0.065),0.000 + 0.5*(0.000-0.015) + 0.001)
 			-QPointF(metric.width(value)/2,-metric.height()/2),value);
 
 
-		if (sheet->getString("sheet.title") != "") {
-			value = sheet->getString("sheet.title");
+		if (sheet->getString(var_sheet_title) != "") {
+			value = sheet->getString(var_sheet_title);
 		} else {
-			value = editor->getEditDocument()->getString("document.title");
+			value = editor->getEditDocument()->getString(var_document_title);
 		}
 		painter->drawText(local(0.065 + 0.5*(0.135-0.065),0.015 + 0.5*(0.015-0.040) + 0.001)
 			-QPointF(metric.width(value)/2,-metric.height()/2),value);
 
 
-		value = editor->getEditDocument()->getString("document.company");
+		value = editor->getEditDocument()->getString(var_document_company);
 		painter->drawText(local(0.135 + 0.5*(0.185-0.135),0.025 + 0.5*(0.025-0.040) + 0.001)
 			-QPointF(metric.width(value)/2,-metric.height()/2),value);
 
@@ -742,6 +972,7 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 			//Qt::AlignCenter,editor->getEditDocument()->getString("document.title"));
 
 #undef local
+#undef local_point
 	} else {
 
 	}
@@ -754,47 +985,6 @@ void GLScene::drawSchematicsPage(QPainter *painter) {
 }
 
 
-////////////////////////////////////////////////////////////////////////////////
-/// @brief
-////////////////////////////////////////////////////////////////////////////////
-void GLScene::drawScreenQuad() {
-	//Setup correct projection-view matrix (all views)
-	glMatrixMode(GL_PROJECTION);
-	glPushMatrix();
-	glLoadIdentity();
-	glOrtho(-1, 1, -1, 1, 1.0f, 500.0f);
-	glMatrixMode(GL_MODELVIEW);
-	glPushMatrix();
-	glLoadIdentity();
-
-	glTranslatef(0.0, 0.0, -1.0);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_CULL_FACE);
-	glEnable(GL_TEXTURE_2D);
-
-	//Draw screen quad
-	glBegin(GL_QUADS);
-		glTexCoord2f( 0.0f, 1.0f);
-		glVertex2f(-1, 1);
-		glTexCoord2f( 1.0f, 1.0f);
-		glVertex2f( 1, 1);
-		glTexCoord2f( 1.0f, 0.0f);
-		glVertex2f( 1,-1);
-		glTexCoord2f( 0.0f, 0.0f);
-		glVertex2f(-1,-1);
-	glEnd();
-
-	//Restore state
-	glDisable(GL_TEXTURE_2D);
-	glMatrixMode(GL_PROJECTION);
-	glPopMatrix();
-	glMatrixMode(GL_MODELVIEW);
-	glPopMatrix();
-}
-
-
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -805,87 +995,71 @@ void GLScene::recursiveSelect(Object* object) {
 	}
 }
 
-void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
-	if ((painter->paintEngine()->type() != QPaintEngine::OpenGL) &&
-		(painter->paintEngine()->type() != QPaintEngine::OpenGL2)) {
-		qWarning("GLScene: requires valid OpenGL context");
-		return;
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check if the previous frame can be displayed again.
+///
+/// Frame is kept in the FXAA buffer, so it can only be reused when FXAA is enabled.
+/// Remembers the current state, so the next call returns true unless camera,
+/// geometry, selection or render settings change.
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::isFrameCacheValid(const QRectF& rect) {
+	if (GLC_State::isInSelectionMode() || (!fbo_fxaa) || makingScreenshot) {
+		frameValid = false;
+		return false;
 	}
 
-	//Initialize scene
-	if (!sceneInitialized) {
-		sceneInitialized = true;
-
-		//GLC author says this fixes "VSYNC problem under MacOS X". I don't care about macs
-		#if defined(Q_OS_MAC)
-		const GLint swapInterval = 1;
-		CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &swapInterval);
-		#endif
-
-		viewport->initGl();
-		previousRect = QRectF(0,0,0,0);
-		doCenter();
-
-		//Load shaders
-		loadShaders();
+	FrameState state;
+	state.modelview = GLC_Context::current()->modelViewMatrix();
+	state.projection = GLC_Context::current()->projectionMatrix();
+	state.rect = rect;
+	state.geometryGeneration = geometryGeneration;
+	state.instancedGeneration = instanced_renderer->getGeneration();
+	state.frameGeneration = frameGeneration;
+	state.selected = editor->getSelected();
+	state.shadowed = sceneShadowed;
+	state.wireframe = sceneWireframe;
+	state.moverActive = controller.hasActiveMover();
+	state.outlineThickness = fw_editor_settings->value("rendering.outline_thickness").toDouble();
+	state.shadowRadius = fw_editor_settings->value("rendering.shadow_blur_radius").toDouble();
+
+	if (frameValid &&
+		(frameState.modelview == state.modelview) &&
+		(frameState.projection == state.projection) &&
+		(frameState.rect == state.rect) &&
+		(frameState.geometryGeneration == state.geometryGeneration) &&
+		(frameState.instancedGeneration == state.instancedGeneration) &&
+		(frameState.frameGeneration == state.frameGeneration) &&
+		(frameState.selected == state.selected) &&
+		(frameState.shadowed == state.shadowed) &&
+		(frameState.wireframe == state.wireframe) &&
+		(frameState.moverActive == state.moverActive) &&
+		(frameState.outlineThickness == state.outlineThickness) &&
+		(frameState.shadowRadius == state.shadowRadius)) {
+		return true;
 	}
 
-	//Setup native rendering and viewport size
-	painter->beginNativePainting();
-	glClearColor(1.0f,1.0f,1.0f,0.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	viewport->setWinGLSize(rect.width(), rect.height());
-	geometryChanged(rect);
-	if (rect != previousRect) {
-		previousRect = rect;
+	frameValid = true;
+	frameState = state;
+	return false;
+}
 
-		if (fbo_outline) delete fbo_outline;
-		if (fbo_outline_selected) delete fbo_outline_selected;
-		if (fbo_shadow) delete fbo_shadow;
-		if (fbo_fxaa) delete fbo_fxaa;
-		fbo_outline = new QGLFramebufferObject((int)rect.width(),(int)rect.height(),QGLFramebufferObject::Depth,GL_TEXTURE_2D,GL_RGBA8);
-		fbo_outline_selected = new QGLFramebufferObject((int)rect.width(),(int)rect.height(),QGLFramebufferObject::Depth,GL_TEXTURE_2D,GL_RGBA8);
-		fbo_shadow = new QGLFramebufferObject((int)rect.width(),(int)rect.height(),QGLFramebufferObject::Depth,GL_TEXTURE_2D,GL_RGBA8);
-		if (fw_editor_settings->value("rendering.use_fxaa") == true) {
-			fbo_fxaa = new QGLFramebufferObject((int)rect.width(),(int)rect.height(),QGLFramebufferObject::Depth,GL_TEXTURE_2D,GL_RGBA8);
-		} else {
-			fbo_fxaa = 0;
-		}
-	}
 
-	//Use orthographic view
-	if (schematics_editor) {
-		viewport->setToOrtho(true);
-	} else {
-		viewport->setToOrtho(sceneOrthographic);
-	}
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draw scene with all its passes into the FXAA buffer (or on screen)
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::drawScene(const QRectF& rect) {
 	bool inSelectionMode = GLC_State::isInSelectionMode();
 
-	//Process selection from the editor
-	world->collection()->unselectAll();
-	if (editor->getSelected()) {
-		recursiveSelect(editor->getSelected());
-	}
-
-	//Setup culling and LOD usage
-	if (makingScreenshot) {
-		viewport->setMinimumPixelCullingSize(0);
-		world->collection()->setLodUsage(false,viewport);
-	} else {
-		viewport->setMinimumPixelCullingSize(fw_editor_settings->value("rendering.min_pixel_culling").toInt());
-		world->collection()->setLodUsage(true,viewport);
-	}
-
-
 	//==========================================================================
 	//Clear screen and buffers
 	glClearColor(1.0f,1.0f,1.0f,0.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	if (fbo_outline) {
 		fbo_outline->bind();
+			if (fbo_outline_attachment) setDrawBuffers(2);
 			glClearColor(0.0f,0.0f,0.0f,0.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (fbo_outline_attachment) setDrawBuffers(1);
 		fbo_outline->release();
 	}
 	if (fbo_outline_selected) {
@@ -894,12 +1068,6 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		fbo_outline_selected->release();
 	}
-	if (fbo_shadow) {
-		fbo_shadow->bind();
-			glClearColor(0.0f,0.0f,0.0f,0.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		fbo_shadow->release();
-	}
 	if (fbo_fxaa) {
 		fbo_fxaa->bind();
 			glClearColor(1.0f,1.0f,1.0f,0.0f);
@@ -910,32 +1078,33 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 
 	//==========================================================================
 	//Draw background
-	if ((!inSelectionMode) && (!schematics_editor)) {
-		if (fbo_fxaa) fbo_fxaa->bind();
-			if (shader_background) {
-				shader_background->bind();
-				shader_background->setUniformValue("v_baseColor",190.0f,190.0f,230.0f);
-				drawScreenQuad();
-				shader_background->release();
-			}
-		if (fbo_fxaa) fbo_fxaa->release();
+	if ((!inSelectionMode) && (!schematics_editor) && shader_background) {
+		ScreenPassChain chain;
+		ScreenPass& background = chain.add(shader_background,fbo_fxaa);
+		background.setUniform("v_baseColor",190.0f,190.0f,230.0f);
+
+		viewport->useClipPlane(false);
+		chain.run();
+		viewport->useClipPlane(true);
 	}
 
 
-	//==========================================================================
-	//Prepare scene rendering
-    GLC_Context::current()->glcLoadIdentity();
-	viewport->setDistMinAndMax(world->collection()->boundingBox()); //Clipping planes defined by bounding box
-	viewport->glExecuteCam(); //Camera
-	viewport->useClipPlane(true); //Enable section plane
-	light[0]->setPosition(viewport->cameraHandle()->eye() - viewport->cameraHandle()->forward() * 1000.0); //Parallel lighting
-	light[0]->glExecute(); //Scene light #1
-
 	//Draw into outline buffer
 	if ((!inSelectionMode) && fbo_outline) {
 		fbo_outline->bind();
-			world->render(0, glc::OutlineSilhouetteRenderFlag);
-			world->render(1, glc::OutlineSilhouetteRenderFlag);
+			if (fbo_outline_attachment) {
+				//Selected objects are drawn first into both attachments, so the second
+				//one holds their complete silhouette. Depth test makes the first one
+				//same as if selected objects were drawn last
+				setDrawBuffers(2);
+				world->render(1, glc::OutlineSilhouetteRenderFlag);
+				setDrawBuffers(1);
+				world->render(0, glc::OutlineSilhouetteRenderFlag);
+			} else {
+				world->render(0, glc::OutlineSilhouetteRenderFlag);
+				world->render(1, glc::OutlineSilhouetteRenderFlag);
+			}
+			instanced_renderer->render(shader_instanced, viewport, true, !makingScreenshot);
 		fbo_outline->release();
 	}
 	if ((!inSelectionMode) && fbo_outline_selected) {
@@ -945,47 +1114,24 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 	}
 
 
-	//Draw into shadows buffer
+	//Draw shadows (shadow buffer is reused while camera and geometry are unchanged)
 	if ((!inSelectionMode) && fbo_shadow && shader_shadow && sceneShadowed && (!schematics_editor)) {
-		fbo_shadow->bind();
-			GLC_Context::current()->glcPushMatrix();
-			GLC_Context::current()->glcTranslated(0,0,1.2*world->collection()->boundingBox().lowerCorner().z());
-			GLC_Context::current()->glcScaled(1,1,0);
-				//viewport->setWinGLSize(rect.width()/2, rect.height()/2);
-				world->collection()->setLodUsage(false,viewport);
-
-				world->render(0, glc::ShadingFlag);
-				world->render(1, glc::ShadingFlag);
-
-				world->collection()->setLodUsage(true,viewport);
-				//viewport->setWinGLSize(rect.width(), rect.height());
-			GLC_Context::current()->glcPopMatrix();
-		fbo_shadow->release();
-
-		//Make shadows even more blurry
-		for (int i = 0; i < 8; i++) {
-			fbo_shadow->bind();
-				viewport->useClipPlane(false);
-				glBindTexture(GL_TEXTURE_2D, fbo_shadow->texture());
-				shader_shadow->bind();
-				shader_shadow->setUniformValue("s_Data",0);
-				shader_shadow->setUniformValue("v_invScreenSize",1.0f/rect.width(),1.0f/rect.height());
-				drawScreenQuad();
-				shader_shadow->release();
-				viewport->useClipPlane(true);
-			fbo_shadow->release();
+		float radius = fw_editor_settings->value("rendering.shadow_blur_radius").toFloat();
+		if (!isShadowCacheValid(radius)) {
+			drawShadow(rect, radius);
 		}
 
-		if (fbo_fxaa) fbo_fxaa->bind();
-			viewport->useClipPlane(false);
-			glBindTexture(GL_TEXTURE_2D, fbo_shadow->texture());
-			shader_shadow->bind();
-			shader_shadow->setUniformValue("s_Data",0);
-			shader_shadow->setUniformValue("v_invScreenSize",1.0f/rect.width(),1.0f/rect.height());
-			drawScreenQuad();
-			shader_shadow->release();
-			viewport->useClipPlane(true);
-		if (fbo_fxaa) fbo_fxaa->release();
+		ScreenPassChain chain;
+		ScreenPass& shadow = chain.add(shader_shadow,fbo_fxaa);
+		shadow.textures[0] = fbo_shadow->texture();
+		shadow.textureScale = textureScale(fbo_shadow,shadowSize);
+		shadow.setUniform("s_Data",(GLint)0);
+		shadow.setUniform("b_blur",(GLint)0);
+		shadow.setUniform("f_opacity",0.40f);
+
+		viewport->useClipPlane(false);
+		chain.run();
+		viewport->useClipPlane(true);
 	}
 
 	//Render scene into world
@@ -994,6 +1140,7 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 			world->render(0, glc::ShadingFlag);
 			//glClear(GL_DEPTH_BUFFER_BIT);
 			world->render(1, glc::ShadingFlag);
+			instanced_renderer->render(shader_instanced, viewport, false, !makingScreenshot);
 		}
 		if (!makingScreenshot) {
 			viewport->useClipPlane(false);
@@ -1009,25 +1156,24 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 
 	//Draw object outlines
 	if ((!inSelectionMode) && fbo_outline && shader_outline) {
-		if (fbo_fxaa) fbo_fxaa->bind();
-			shader_outline->bind();
-			shader_outline->setUniformValue("s_Data",0);
-			shader_outline->setUniformValue("v_invScreenSize",1.0f/rect.width(),1.0f/rect.height());
-			if (schematics_editor) {
-				float thickness = fabs(project(0.0,0.0).y() - project(0.0,0.0007f).y())*0.5f;
-				if (thickness < 0.5) thickness = 0.5;
-				shader_outline->setUniformValue("f_outlineThickness",thickness);
-			} else {
-				shader_outline->setUniformValue("f_outlineThickness",
-					(GLfloat)fw_editor_settings->value("rendering.outline_thickness").toDouble()
-				);
-			}
-				glBindTexture(GL_TEXTURE_2D, fbo_outline->texture());
-				drawScreenQuad();
-				glBindTexture(GL_TEXTURE_2D, fbo_outline_selected->texture());
-				drawScreenQuad();
-			shader_outline->release();
-		if (fbo_fxaa) fbo_fxaa->release();
+		float thickness;
+		if (schematics_editor) {
+			thickness = fabs(project(0.0,0.0).y() - project(0.0,0.0007f).y())*0.5f;
+			if (thickness < 0.5) thickness = 0.5;
+		} else {
+			thickness = fw_editor_settings->value("rendering.outline_thickness").toFloat();
+		}
+
+		ScreenPassChain chain;
+		ScreenPass& outline = chain.add(shader_outline,fbo_fxaa);
+		outline.textures[0] = fbo_outline->texture();
+		outline.textures[1] = fbo_outline_attachment ? fbo_outline_attachment : fbo_outline_selected->texture();
+		outline.textureScale = textureScale(fbo_outline,frameSize);
+		outline.setUniform("s_Data",(GLint)0);
+		outline.setUniform("s_Selected",(GLint)1);
+		outline.setUniform("v_invScreenSize",1.0f/fbo_outline->width(),1.0f/fbo_outline->height());
+		outline.setUniform("f_outlineThickness",thickness);
+		chain.run();
 	}
 
 	//Draw schematics
@@ -1050,14 +1196,14 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 			//Draw CM indicator
 			glClear(GL_DEPTH_BUFFER_BIT);
 			if (editor->getSelected()) {
-				bool cm1 = editor->getSelected()->isInformationDefined("total_cm");
-				bool cm2 = editor->getSelected()->isInformationDefined("cm");
+				bool cm1 = editor->getSelected()->isInformationDefined(ObjectInformation::TOTAL_CM);
+				bool cm2 = editor->getSelected()->isInformationDefined(ObjectInformation::CM);
 				if (cm1 || cm2) {
 					QVector3D position = QVector3D();
 					if (cm1) {
-						position = editor->getSelected()->getInformationVector("total_cm");
+						position = editor->getSelected()->getInformationVector(ObjectInformation::TOTAL_CM);
 					} else {
-						position = editor->getSelected()->getInformationVector("cm");
+						position = editor->getSelected()->getInformationVector(ObjectInformation::CM);
 					}
 
 					indicator_cm->resetMatrix();
@@ -1070,17 +1216,357 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 			controller.drawActiveMoverRep();
 		if (fbo_fxaa) fbo_fxaa->release();
 	}
-	
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check if shadow buffer can be reused.
+///
+/// Must be called after camera is set up. Remembers the current state, so the next
+/// call returns true unless camera, geometry or blur radius change.
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::isShadowCacheValid(float radius) {
+	GLC_Matrix4x4 modelview = GLC_Context::current()->modelViewMatrix();
+	GLC_Matrix4x4 projection = GLC_Context::current()->projectionMatrix();
+	if (shadowValid &&
+		(shadowModelView == modelview) &&
+		(shadowProjection == projection) &&
+		(shadowGeometryGeneration == geometryGeneration) &&
+		(shadowInstancedGeneration == instanced_renderer->getGeneration()) &&
+		(shadowRadius == radius)) {
+		return true;
+	}
+
+	shadowValid = true;
+	shadowModelView = modelview;
+	shadowProjection = projection;
+	shadowGeometryGeneration = geometryGeneration;
+	shadowInstancedGeneration = instanced_renderer->getGeneration();
+	shadowRadius = radius;
+	return false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draw shadow into fbo_shadow and blur it.
+///
+/// Scene is flattened onto the plane under it and drawn in reduced resolution. The
+/// result is blurred with a separable gaussian filter: horizontal pass goes into
+/// fbo_shadow_blur, vertical pass goes back into fbo_shadow.
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::drawShadow(const QRectF& rect, float radius) {
+	//Draw flattened scene
+	fbo_shadow->bind();
+		viewport->setWinGLSize(shadowSize.width(), shadowSize.height());
+		glClearColor(0.0f,0.0f,0.0f,0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		GLC_Context::current()->glcPushMatrix();
+		GLC_Context::current()->glcTranslated(0,0,1.2*getBoundingBox().lowerCorner().z());
+		GLC_Context::current()->glcScaled(1,1,0);
+			world->collection()->setLodUsage(false,viewport);
+
+			world->render(0, glc::ShadingFlag);
+			world->render(1, glc::ShadingFlag);
+			instanced_renderer->render(shader_instanced, viewport, false, false);
+
+			world->collection()->setLodUsage(true,viewport);
+		GLC_Context::current()->glcPopMatrix();
+	fbo_shadow->release();
+
+	//Radius is given in screen pixels, taps are spread over it. Blur passes replace
+	//contents of the target buffer
+	float step = (radius / shadowDownsample) / 7.0f;
+	ScreenPassChain chain;
+	ScreenPass& horizontal = chain.add(shader_shadow,fbo_shadow_blur);
+	horizontal.textures[0] = fbo_shadow->texture();
+	horizontal.textureScale = textureScale(fbo_shadow,shadowSize);
+	horizontal.blend = false;
+	horizontal.setUniform("s_Data",(GLint)0);
+	horizontal.setUniform("b_blur",(GLint)1);
+	horizontal.setUniform("f_opacity",1.0f);
+	horizontal.setUniform("v_blurStep",step/fbo_shadow->width(),0.0f);
+
+	ScreenPass& vertical = chain.add(shader_shadow,fbo_shadow);
+	vertical.textures[0] = fbo_shadow_blur->texture();
+	vertical.textureScale = textureScale(fbo_shadow_blur,shadowSize);
+	vertical.blend = false;
+	vertical.setUniform("s_Data",(GLint)0);
+	vertical.setUniform("b_blur",(GLint)1);
+	vertical.setUniform("f_opacity",1.0f);
+	vertical.setUniform("v_blurStep",0.0f,step/fbo_shadow_blur->height());
+
+	//Targets may be larger than the used part, so the unused part is cleared
+	fbo_shadow_blur->bind();
+		glClear(GL_COLOR_BUFFER_BIT);
+	fbo_shadow_blur->release();
+
+	viewport->useClipPlane(false);
+	chain.run();
+	viewport->useClipPlane(true);
+	viewport->setWinGLSize(rect.width(), rect.height());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Attach selection buffer as the second colour attachment of the outline framebuffer.
+///
+/// Selected objects are written into both attachments at once, so the selection
+/// outline does not need a separate geometry pass.
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::createOutlineAttachment(int width, int height) {
+	const QGLContext* context = QGLContext::currentContext();
+	if (!context) return false;
+
+	//Check for multiple render targets support
+	if (!drawBuffers) {
+		drawBuffers = (FWE_DrawBuffersProc)context->getProcAddress("glDrawBuffers");
+		if (!drawBuffers) drawBuffers = (FWE_DrawBuffersProc)context->getProcAddress("glDrawBuffersARB");
+		if (!drawBuffers) return false;
+	}
+	GLint max_draw_buffers = 0;
+	glGetIntegerv(GL_MAX_DRAW_BUFFERS, &max_draw_buffers);
+	if (max_draw_buffers < 2) return false;
+
+	//Create texture in the same format as the outline buffer
+	glGenTextures(1, &fbo_outline_attachment);
+	glBindTexture(GL_TEXTURE_2D, fbo_outline_attachment);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//Attach it
+	QGLFunctions functions(context);
+	fbo_outline->bind();
+		functions.glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, fbo_outline_attachment, 0);
+		GLenum status = functions.glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			functions.glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
+		}
+	fbo_outline->release();
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		glDeleteTextures(1, &fbo_outline_attachment);
+		fbo_outline_attachment = 0;
+		return false;
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::removeOutlineAttachment() {
+	if (!fbo_outline_attachment) return;
+
+	QGLFunctions functions(QGLContext::currentContext());
+	fbo_outline->bind();
+		functions.glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
+	fbo_outline->release();
+	glDeleteTextures(1, &fbo_outline_attachment);
+	fbo_outline_attachment = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Make sure render target fits the given size.
+///
+/// Targets are shared between scenes, so filtering is set up every time a new
+/// target is taken from the pool.
+////////////////////////////////////////////////////////////////////////////////
+bool GLScene::resizeRenderTarget(QGLFramebufferObject** target, const QSize& size,
+								 QGLFramebufferObject::Attachment attachment, GLenum filter) {
+	if (*target && RenderTargetPool::fits(*target,size)) return false;
+
+	RenderTargetPool::release(*target);
+	*target = RenderTargetPool::acquire(size,attachment);
+
+	glBindTexture(GL_TEXTURE_2D, (*target)->texture());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QSizeF GLScene::textureScale(QGLFramebufferObject* target, const QSize& size) {
+	return QSizeF(((float)size.width()) / target->width(),((float)size.height()) / target->height());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Return render targets into the pool.
+///
+/// Must be called with the views OpenGL context current. Cached shadow and frame
+/// are lost, targets are taken from the pool again when the scene is drawn.
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::releaseRenderTargets() {
+	removeOutlineAttachment();
+	RenderTargetPool::release(fbo_outline);
+	RenderTargetPool::release(fbo_outline_selected);
+	RenderTargetPool::release(fbo_shadow);
+	RenderTargetPool::release(fbo_shadow_blur);
+	RenderTargetPool::release(fbo_fxaa);
+	fbo_outline = 0;
+	fbo_outline_selected = 0;
+	fbo_shadow = 0;
+	fbo_shadow_blur = 0;
+	fbo_fxaa = 0;
+
+	previousRect = QRectF(0,0,0,0);
+	shadowValid = false;
+	frameValid = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write into first "count" colour attachments of the bound framebuffer
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::setDrawBuffers(int count) {
+	static const GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	if (drawBuffers) drawBuffers(count, buffers);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
+	if ((painter->paintEngine()->type() != QPaintEngine::OpenGL) &&
+		(painter->paintEngine()->type() != QPaintEngine::OpenGL2)) {
+		qWarning("GLScene: requires valid OpenGL context");
+		return;
+	}
+
+	//Update transformations of all objects moved since the last frame
+	editor->updateTransformations();
+
+	//Initialize scene
+	if (!sceneInitialized) {
+		sceneInitialized = true;
+
+		//GLC author says this fixes "VSYNC problem under MacOS X". I don't care about macs
+		#if defined(Q_OS_MAC)
+		const GLint swapInterval = 1;
+		CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &swapInterval);
+		#endif
+
+		viewport->initGl();
+		previousRect = QRectF(0,0,0,0);
+		doCenter();
+
+		//Keep geometry in vertex buffers. It's uploaded once and only re-uploaded
+		//when the mesh is regenerated
+		if (FWE_GLScene_UseVBO()) {
+			GLC_State::setVboUsage(true);
+			world->collection()->setVboUsage(true);
+			sceneUseVBO = true;
+		}
+
+		//Load shaders
+		loadShaders();
+	}
+
+	//Setup native rendering and viewport size
+	painter->beginNativePainting();
+	glClearColor(1.0f,1.0f,1.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	viewport->setWinGLSize(rect.width(), rect.height());
+	geometryChanged(rect);
+	if (rect != previousRect) {
+		previousRect = rect;
+
+		frameSize = QSize((int)rect.width(),(int)rect.height());
+
+		//Shadows are blurry anyway, so they are drawn in lower resolution
+		shadowDownsample = fw_editor_settings->value("rendering.shadow_downsample").toInt();
+		if (shadowDownsample < 1) shadowDownsample = 1;
+		shadowSize = QSize(qMax(1,frameSize.width() / shadowDownsample),qMax(1,frameSize.height() / shadowDownsample));
+
+		//Render targets are kept while they fit the view
+		if (fbo_outline && (!RenderTargetPool::fits(fbo_outline,frameSize))) removeOutlineAttachment();
+		resizeRenderTarget(&fbo_outline,frameSize,QGLFramebufferObject::Depth,GL_NEAREST);
+		if (fbo_outline_attachment || createOutlineAttachment(fbo_outline->width(),fbo_outline->height())) {
+			RenderTargetPool::release(fbo_outline_selected);
+			fbo_outline_selected = 0;
+		} else { //Fall back to a separate pass for selected objects (must be same size as fbo_outline)
+			if (fbo_outline_selected && (fbo_outline_selected->size() != fbo_outline->size())) {
+				RenderTargetPool::release(fbo_outline_selected);
+				fbo_outline_selected = 0;
+			}
+			resizeRenderTarget(&fbo_outline_selected,fbo_outline->size(),QGLFramebufferObject::Depth,GL_NEAREST);
+		}
+		resizeRenderTarget(&fbo_shadow,shadowSize,QGLFramebufferObject::Depth,GL_LINEAR); //Shadows are upscaled with filtering
+		resizeRenderTarget(&fbo_shadow_blur,shadowSize,QGLFramebufferObject::NoAttachment,GL_LINEAR);
+		if (fw_editor_settings->value("rendering.use_fxaa") == true) {
+			resizeRenderTarget(&fbo_fxaa,frameSize,QGLFramebufferObject::Depth,GL_NEAREST);
+		} else {
+			RenderTargetPool::release(fbo_fxaa);
+			fbo_fxaa = 0;
+		}
+		shadowValid = false;
+		frameValid = false;
+	}
+
+	//Use orthographic view
+	if (schematics_editor) {
+		viewport->setToOrtho(true);
+	} else {
+		viewport->setToOrtho(sceneOrthographic);
+	}
+	bool inSelectionMode = GLC_State::isInSelectionMode();
+
+	//Process selection from the editor
+	world->collection()->unselectAll();
+	if (editor->getSelected()) {
+		recursiveSelect(editor->getSelected());
+	}
+
+	//Setup culling and LOD usage
+	if (makingScreenshot) {
+		viewport->setMinimumPixelCullingSize(0);
+		world->collection()->setLodUsage(false,viewport);
+	} else {
+		viewport->setMinimumPixelCullingSize(fw_editor_settings->value("rendering.min_pixel_culling").toInt());
+		world->collection()->setLodUsage(true,viewport);
+	}
+
+
+	//==========================================================================
+	//Prepare scene rendering
+	GLC_Context::current()->glcLoadIdentity();
+	viewport->setDistMinAndMax(getBoundingBox()); //Clipping planes defined by bounding box
+	viewport->glExecuteCam(); //Camera
+	viewport->useClipPlane(true); //Enable section plane
+	light[0]->setPosition(viewport->cameraHandle()->eye() - viewport->cameraHandle()->forward() * 1000.0); //Parallel lighting
+	light[0]->glExecute(); //Scene light #1
+	updateProjection();
+
+	//Draw scene, unless only UI overlays changed since the previous frame
+	if (!isFrameCacheValid(rect)) {
+		drawScene(rect);
+	}
+	viewport->useClipPlane(false);
+
 
 	//==========================================================================
 	//End FXAA and display it on screen
 	if ((!inSelectionMode) && fbo_fxaa) {
-		glBindTexture(GL_TEXTURE_2D, fbo_fxaa->texture());
-		shader_fxaa->bind();
-		shader_fxaa->setUniformValue("textureSampler",0);
-		shader_fxaa->setUniformValue("texcoordOffset",1.0f/((float)rect.width()),1.0f/((float)rect.height()));
-		drawScreenQuad();
-		shader_fxaa->release();
+		ScreenPassChain chain;
+		ScreenPass& fxaa = chain.add(shader_fxaa,0);
+		fxaa.textures[0] = fbo_fxaa->texture();
+		fxaa.textureScale = textureScale(fbo_fxaa,frameSize);
+		fxaa.setUniform("textureSampler",(GLint)0);
+		fxaa.setUniform("texcoordOffset",1.0f/((float)fbo_fxaa->width()),1.0f/((float)fbo_fxaa->height()));
+		chain.run();
 	}
 
 	//Draw 2D schematics page
@@ -1089,7 +1575,7 @@ void GLScene::drawBackground(QPainter *painter, const QRectF& rect) {
 			viewport->useClipPlane(false);
 				//QPainter fbo_painter(fbo_fxaa);
 				//if (makingScreenshot) {
-					drawSchematicsPage(painter);
+					drawSchematicsOverlay(painter);
 				//} else {
 					//drawSchematicsPage(&fbo_painter);
 				//}
@@ -32,6 +32,8 @@
 #include <QGLWidget>
 #include <QGLShader>
 #include <QGLFramebufferObject>
+#include <QMatrix4x4>
+#include <QPicture>
 
 #include <GLC_Factory>
 #include <GLC_Light>
@@ -44,6 +46,10 @@ namespace EVDS {
 	class Object;
 	class Editor;
 	class SchematicsEditor;
+	class InstancedRenderer;
+
+	typedef void (APIENTRY *FWE_DrawBuffersProc)(GLsizei n, const GLenum* bufs);
+
 	class GLScene : public QGraphicsScene
 	{
 		Q_OBJECT
@@ -53,10 +59,23 @@ namespace EVDS {
 		~GLScene();
 
 		GLC_3DViewCollection* getCollection() { return world->collection(); }
+		//Copy transformation and visibility into the instance stored in collection (adds instance if it's not there)
+		void updateInstance(const GLC_3DViewInstance& instance);
+		//Renderer for copies of objects (drawn with hardware instancing)
+		InstancedRenderer* getInstancedRenderer() { return instanced_renderer; }
+		//Bounding box of everything in the scene (including instanced copies)
+		GLC_BoundingBox getBoundingBox();
+		//Geometry was changed, cached images of the scene must be redrawn
+		void invalidateGeometry() { geometryGeneration++; }
+		//Something else visible in the scene was changed, previous frame must not be reused
+		void invalidateFrame() { frameGeneration++; }
+		//Schematics sheet or its elements were changed, page layout and labels must be redrawn
+		void invalidateOverlay() { overlayValid = false; }
 
 		QGLShaderProgram* compileShader(const QString& name);
 		void loadShaders();
-		void drawScreenQuad();
+		//Return all render targets into the pool (they are taken again on the next frame)
+		void releaseRenderTargets();
 		//void selectByCoordinates(int x, int y, bool multi, QMouseEvent* pMouseEvent);
 
 		void setCutsectionPlane(int plane, bool active);
@@ -86,18 +105,42 @@ namespace EVDS {
 		void cutsectionUpdated();
 
 	private:
-		//Save a single snapshot of a sheet
-		void saveCurrentSheet(const QString& baseFilename);
+		//Save a single snapshot of a sheet (as TIFF image, rendered in tiles). Returns false if file could not be written
+		bool saveCurrentSheet(const QString& baseFilename);
 		//Create panels and interface
 		void createInterface();
 		//Recursively GLC-select object and its children
 		void recursiveSelect(Object* object);
+		//Draw schematics page layout and labels (replays cached picture when possible)
+		void drawSchematicsOverlay(QPainter *painter);
 		//Draw schematics page layout
 		void drawSchematicsPage(QPainter *painter);
 		//Draw schematics page element
 		void drawSchematicsElement(QPainter *painter, Object* element, QPointF offset);
+		//Compute projection into window coordinates for the current camera (once per frame)
+		void updateProjection();
 		//Project coordinates
 		QPointF project(float x, float y, float z = 0.0);
+		//Project many points on the XY plane at once
+		QVector<QPointF> project(const QVector<QPointF>& points);
+		//Can the previous frame be displayed again instead of drawing the scene
+		bool isFrameCacheValid(const QRectF& rect);
+		//Draw all passes of the scene
+		void drawScene(const QRectF& rect);
+		//Is shadow texture still valid for the current camera and geometry
+		bool isShadowCacheValid(float radius);
+		//Render shadow projection into the downsampled buffer and blur it
+		void drawShadow(const QRectF& rect, float radius);
+		//Attach selection buffer to the outline framebuffer (returns false if multiple render targets are not supported)
+		bool createOutlineAttachment(int width, int height);
+		//Detach and destroy selection buffer
+		void removeOutlineAttachment();
+		//Take a new render target from the pool, if current one does not fit the size. Returns true if target was replaced
+		bool resizeRenderTarget(QGLFramebufferObject** target, const QSize& size, QGLFramebufferObject::Attachment attachment, GLenum filter);
+		//Texture coordinates of the used part of a render target
+		static QSizeF textureScale(QGLFramebufferObject* target, const QSize& size);
+		//Select how many colour attachments of the bound framebuffer are written
+		void setDrawBuffers(int count);
 
 		//Parent scene from which GLC stuff is taken
 		GLScene* parent_scene;
@@ -123,24 +166,68 @@ namespace EVDS {
 		GLC_3DWidgetManager* widget_manager;
 		GLC_Plane* cutsectionPlane[3];
 		int cutsectionPlaneWidget[3];
+		InstancedRenderer* instanced_renderer;
 
 		//Is scene initialized OpenGL-wise
 		bool sceneOrthographic;
 		bool sceneShadowed;
 		bool sceneWireframe;
+		bool sceneUseVBO;
 		bool sceneInitialized;
 		bool makingScreenshot;
 		QRectF previousRect;
+		QMatrix4x4 windowMatrix; //Transforms world coordinates into window coordinates
+		int geometryGeneration;
+		int frameGeneration;
+
+		//State from which the previous frame was drawn
+		struct FrameState {
+			GLC_Matrix4x4 modelview;
+			GLC_Matrix4x4 projection;
+			QRectF rect;
+			int geometryGeneration;
+			int instancedGeneration;
+			int frameGeneration;
+			Object* selected;
+			bool shadowed;
+			bool wireframe;
+			bool moverActive;
+			double outlineThickness;
+			double shadowRadius;
+		};
+		bool frameValid;
+		FrameState frameState;
+
+		//Schematics page layout and labels, recorded relative to the sheet origin
+		bool overlayValid;
+		QPicture overlayPicture;
+		QMatrix4x4 overlayMatrix;
+		Object* overlaySheet;
+
+		//Shadow texture is reused while these stay the same
+		bool shadowValid;
+		GLC_Matrix4x4 shadowModelView;
+		GLC_Matrix4x4 shadowProjection;
+		int shadowGeometryGeneration;
+		int shadowInstancedGeneration;
+		float shadowRadius;
 
 		//Shaders and framebuffers
 		QGLFramebufferObject* fbo_outline;
 		QGLFramebufferObject* fbo_outline_selected;
 		QGLFramebufferObject* fbo_shadow;
+		QGLFramebufferObject* fbo_shadow_blur; //Second buffer for separable blur
+		int shadowDownsample; //Shadow buffers are this many times smaller than the screen
+		QSize frameSize; //Used part of full-screen render targets
+		QSize shadowSize; //Used part of shadow render targets
 		QGLFramebufferObject* fbo_fxaa;
+		GLuint fbo_outline_attachment; //Second colour attachment of fbo_outline (selected objects only)
+		FWE_DrawBuffersProc drawBuffers;
 		QGLShaderProgram* shader_background;
 		QGLShaderProgram* shader_outline;
 		QGLShaderProgram* shader_shadow;
 		QGLShaderProgram* shader_fxaa;
+		QGLShaderProgram* shader_instanced;
 	};
 
 	class GLView : public QGraphicsView
@@ -150,10 +237,11 @@ namespace EVDS {
 	public:
 		QSize minimumSizeHint() const { return QSize(200, 100); }
 		QSize sizeHint() const { return QSize(200, 200); }
+		static QGLWidget* getShareWidget();
 
 		GLView(QWidget* parent) : QGraphicsView(parent) {
 			QGLContext* context = new GLC_Context(QGLFormat(QGL::SampleBuffers));
-			QGLWidget* opengl = new QGLWidget(context,this);
+			QGLWidget* opengl = new QGLWidget(context,this,getShareWidget());
 
 			setAcceptDrops(true);
 			setViewport(opengl);
@@ -172,6 +260,15 @@ namespace EVDS {
 		}
 		void dragEnterEvent(QDragEnterEvent *event) {
 		}
+		void hideEvent(QHideEvent *event) {
+			//Hidden view does not need its render targets
+			GLScene* glscene = qobject_cast<GLScene*>(scene());
+			if (glscene) {
+				static_cast<QGLWidget*>(viewport())->makeCurrent();
+				glscene->releaseRenderTargets();
+			}
+			QGraphicsView::hideEvent(event);
+		}
 	};
 }
 
@@ -0,0 +1,430 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#include <QGLContext>
+#include <GLC_Material>
+#include <math.h>
+
+#include "evds.h"
+#include "fwe_evds_instanced_renderer.h"
+
+using namespace EVDS;
+
+//Floats per copy in instance buffer (transformation matrix and identifier)
+#define FWE_INSTANCE_STRIDE 17
+
+#ifndef GL_VERTEX_PROGRAM_TWO_SIDE
+#define GL_VERTEX_PROGRAM_TWO_SIDE 0x8643
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Set fixed-function material state, which is read by the instanced shader
+////////////////////////////////////////////////////////////////////////////////
+static void FWE_SetMaterial(const InstancedMesh::Range& range) {
+	GLfloat ambient[4] = { range.ambient.redF(), range.ambient.greenF(), range.ambient.blueF(), range.ambient.alphaF() };
+	GLfloat diffuse[4] = { range.diffuse.redF(), range.diffuse.greenF(), range.diffuse.blueF(), range.diffuse.alphaF() };
+	GLfloat specular[4] = { range.specular.redF(), range.specular.greenF(), range.specular.blueF(), range.specular.alphaF() };
+	GLfloat emissive[4] = { range.emissive.redF(), range.emissive.greenF(), range.emissive.blueF(), range.emissive.alphaF() };
+	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambient);
+	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuse);
+	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specular);
+	glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, emissive);
+	glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, range.shininess);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+InstancedMesh::InstancedMesh() :
+	vertexBuffer(QGLBuffer::VertexBuffer),
+	normalBuffer(QGLBuffer::VertexBuffer),
+	indexBuffer(QGLBuffer::IndexBuffer) {
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+InstancedMesh::~InstancedMesh() {
+	vertexBuffer.destroy();
+	normalBuffer.destroy();
+	indexBuffer.destroy();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Upload vertices, normals and indices of every LOD into buffers
+////////////////////////////////////////////////////////////////////////////////
+void InstancedMesh::upload(GLC_Mesh* mesh) {
+	GLfloatVector positions = mesh->positionVector();
+	GLfloatVector normals = mesh->normalVector();
+
+	//Indices of all LODs and materials are stored in a single buffer
+	QVector<GLuint> indices;
+	QList<GLC_uint> materials = mesh->materialIds();
+	lods.clear();
+	for (int lod = 0; lod < mesh->lodCount(); lod++) {
+		QList<Range> ranges;
+		for (int i = 0; i < materials.count(); i++) {
+			if (!mesh->containsTriangles(lod,materials[i])) continue;
+			IndexList list = mesh->getTrianglesIndex(lod,materials[i]);
+
+			Range range;
+			range.offset = indices.count();
+			range.count = list.count();
+			GLC_Material* material = mesh->material(materials[i]);
+			range.ambient = material->ambientColor();
+			range.diffuse = material->diffuseColor();
+			range.specular = material->specularColor();
+			range.emissive = material->emissiveColor();
+			range.shininess = material->shininess();
+			for (int j = 0; j < list.count(); j++) {
+				indices.append(list[j]);
+			}
+			ranges.append(range);
+		}
+		lods.append(ranges);
+	}
+
+	//Upload data
+	if (!vertexBuffer.isCreated()) vertexBuffer.create();
+	if (!normalBuffer.isCreated()) normalBuffer.create();
+	if (!indexBuffer.isCreated()) indexBuffer.create();
+
+	vertexBuffer.bind();
+	vertexBuffer.allocate(positions.constData(),positions.count()*sizeof(GLfloat));
+	vertexBuffer.release();
+	normalBuffer.bind();
+	normalBuffer.allocate(normals.constData(),normals.count()*sizeof(GLfloat));
+	normalBuffer.release();
+	indexBuffer.bind();
+	indexBuffer.allocate(indices.constData(),indices.count()*sizeof(GLuint));
+	indexBuffer.release();
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+InstancedRenderer::InstancedRenderer() {
+	extensionsResolved = false;
+	drawElementsInstanced = 0;
+	vertexAttribDivisor = 0;
+	generation = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+InstancedRenderer::~InstancedRenderer() {
+	while (!batches.isEmpty()) {
+		removeBatches(batches.begin().key());
+	}
+	qDeleteAll(meshes);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void InstancedRenderer::setBatches(Object* owner, const QList<InstancedBatch>& new_batches) {
+	removeBatches(owner);
+	generation++;
+
+	QList<Batch*> list;
+	for (int i = 0; i < new_batches.count(); i++) {
+		if (new_batches[i].transformations.isEmpty()) continue;
+		if (new_batches[i].representation->numberOfBody() == 0) continue;
+
+		Batch* batch = new Batch();
+		batch->batch = new_batches[i];
+		batch->mesh = dynamic_cast<GLC_Mesh*>(batch->batch.representation->geomAt(0));
+		batch->instanceBufferValid = false;
+		batch->boundingBoxValid = false;
+		if (batch->mesh) {
+			list.append(batch);
+		} else {
+			delete batch;
+		}
+	}
+	if (!list.isEmpty()) batches[owner] = list;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void InstancedRenderer::removeBatches(Object* owner) {
+	QList<Batch*> list = batches.take(owner);
+	if (!list.isEmpty()) generation++;
+	for (int i = 0; i < list.count(); i++) {
+		list[i]->instanceBuffer.destroy();
+		delete list[i];
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void InstancedRenderer::invalidateMesh(GLC_Mesh* mesh) {
+	delete meshes.take(mesh);
+	generation++;
+
+	//Bounds of copies depend on the mesh
+	QMapIterator<Object*,QList<Batch*> > iterator(batches);
+	while (iterator.hasNext()) {
+		iterator.next();
+		for (int i = 0; i < iterator.value().count(); i++) {
+			if (iterator.value()[i]->mesh == mesh) iterator.value()[i]->boundingBoxValid = false;
+		}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+GLC_BoundingBox InstancedRenderer::boundingBox() {
+	GLC_BoundingBox box;
+	QMapIterator<Object*,QList<Batch*> > iterator(batches);
+	while (iterator.hasNext()) {
+		iterator.next();
+		for (int i = 0; i < iterator.value().count(); i++) {
+			updateBoundingBox(iterator.value()[i]);
+			box.combine(iterator.value()[i]->boundingBox);
+		}
+	}
+	return box;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void InstancedRenderer::updateBoundingBox(Batch* batch) {
+	if (batch->boundingBoxValid) return;
+	batch->boundingBoxValid = true;
+
+	GLC_BoundingBox copy_box = batch->batch.representation->boundingBox();
+	batch->boundingBox = GLC_BoundingBox();
+	for (int i = 0; i < batch->batch.transformations.count(); i++) {
+		GLC_BoundingBox box = copy_box;
+		batch->boundingBox.combine(box.transform(batch->batch.transformations[i]));
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void InstancedRenderer::uploadBatch(Batch* batch) {
+	if (batch->instanceBufferValid) return;
+	batch->instanceBufferValid = true;
+
+	//Column-major matrix followed by identifier
+	int count = batch->batch.transformations.count();
+	QVector<GLfloat> data(count*FWE_INSTANCE_STRIDE);
+	for (int i = 0; i < count; i++) {
+		const double* matrix = batch->batch.transformations[i].getData();
+		for (int j = 0; j < 16; j++) {
+			data[i*FWE_INSTANCE_STRIDE+j] = (GLfloat)matrix[j];
+		}
+		data[i*FWE_INSTANCE_STRIDE+16] = (GLfloat)batch->batch.identifiers[i];
+	}
+
+	if (!batch->instanceBuffer.isCreated()) batch->instanceBuffer.create();
+	batch->instanceBuffer.bind();
+	batch->instanceBuffer.allocate(data.constData(),data.count()*sizeof(GLfloat));
+	batch->instanceBuffer.release();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Select LOD by size of a single copy relative to the visible area
+////////////////////////////////////////////////////////////////////////////////
+int InstancedRenderer::selectLOD(Batch* batch, GLC_Viewport* viewport, int lodCount) {
+	if (lodCount <= 1) return 0;
+
+	GLC_BoundingBox box = batch->batch.representation->boundingBox();
+	double size = (box.upperCorner() - box.lowerCorner()).length();
+	double view_size = 2.0*viewport->cameraHandle()->distEyeTarget()*tan(EVDS_RAD(0.5*viewport->viewAngle()));
+	if (view_size <= 0.0) return 0;
+
+	//Copies bigger than quarter of the view use the most detailed LOD
+	double quality = 4.0*size/view_size;
+	if (quality > 1.0) quality = 1.0;
+	return (int)((1.0 - quality)*(lodCount - 1) + 0.5);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void InstancedRenderer::resolveExtensions() {
+	if (extensionsResolved) return;
+	extensionsResolved = true;
+
+	const QGLContext* context = QGLContext::currentContext();
+	if (!context) return;
+
+	drawElementsInstanced = (FWE_DrawElementsInstancedProc)context->getProcAddress("glDrawElementsInstancedARB");
+	if (!drawElementsInstanced) {
+		drawElementsInstanced = (FWE_DrawElementsInstancedProc)context->getProcAddress("glDrawElementsInstanced");
+	}
+	vertexAttribDivisor = (FWE_VertexAttribDivisorProc)context->getProcAddress("glVertexAttribDivisorARB");
+	if (!vertexAttribDivisor) {
+		vertexAttribDivisor = (FWE_VertexAttribDivisorProc)context->getProcAddress("glVertexAttribDivisor");
+	}
+	if ((!drawElementsInstanced) || (!vertexAttribDivisor)) {
+		qWarning("InstancedRenderer: hardware instancing not supported, copies are drawn one by one");
+		drawElementsInstanced = 0;
+		vertexAttribDivisor = 0;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draw all batches which are inside the view frustum
+////////////////////////////////////////////////////////////////////////////////
+void InstancedRenderer::render(QGLShaderProgram* shader, GLC_Viewport* viewport, bool outline, bool useLODs) {
+	if ((!shader) || batches.isEmpty()) return;
+	resolveExtensions();
+
+	//Copies are lit like GLC lights the originals: material is taken from fixed-function
+	// state, back faces get their own color if light model is two-sided
+	GLboolean two_sided = GL_FALSE;
+	GLboolean color_material = glIsEnabled(GL_COLOR_MATERIAL);
+	glGetBooleanv(GL_LIGHT_MODEL_TWO_SIDE,&two_sided);
+	glDisable(GL_COLOR_MATERIAL);
+	if (two_sided && (!outline)) glEnable(GL_VERTEX_PROGRAM_TWO_SIDE);
+
+	shader->bind();
+	shader->setUniformValue("b_outline",(GLint)(outline ? 1 : 0));
+	int position_attribute = shader->attributeLocation("a_position");
+	int normal_attribute = shader->attributeLocation("a_normal");
+	int instance_attribute = shader->attributeLocation("a_instance");
+	int identifier_attribute = shader->attributeLocation("a_identifier");
+
+	QMapIterator<Object*,QList<Batch*> > iterator(batches);
+	while (iterator.hasNext()) {
+		iterator.next();
+		for (int i = 0; i < iterator.value().count(); i++) {
+			Batch* batch = iterator.value()[i];
+
+			//Cull all copies at once by aggregate bounds
+			updateBoundingBox(batch);
+			if (viewport->frustum().localizeBoundingBox(batch->boundingBox) == GLC_Frustum::OutFrustum) continue;
+
+			//Get uploaded mesh
+			InstancedMesh* mesh = meshes.value(batch->mesh);
+			if (!mesh) {
+				mesh = new InstancedMesh();
+				mesh->upload(batch->mesh);
+				meshes[batch->mesh] = mesh;
+			}
+			if (mesh->lods.isEmpty()) continue;
+
+			//Pick LOD (fall back to the master mesh if this LOD is missing)
+			int lod = 0;
+			if (useLODs) lod = selectLOD(batch,viewport,mesh->lods.count());
+			if (mesh->lods[lod].isEmpty()) lod = 0;
+			const QList<InstancedMesh::Range>& ranges = mesh->lods[lod];
+
+			//Setup mesh data
+			mesh->vertexBuffer.bind();
+			shader->enableAttributeArray(position_attribute);
+			shader->setAttributeBuffer(position_attribute,GL_FLOAT,0,3);
+			mesh->normalBuffer.bind();
+			shader->enableAttributeArray(normal_attribute);
+			shader->setAttributeBuffer(normal_attribute,GL_FLOAT,0,3);
+			mesh->indexBuffer.bind();
+
+			if (drawElementsInstanced) {
+				//Setup per-copy data
+				uploadBatch(batch);
+				batch->instanceBuffer.bind();
+				for (int k = 0; k < 4; k++) {
+					shader->enableAttributeArray(instance_attribute+k);
+					shader->setAttributeBuffer(instance_attribute+k,GL_FLOAT,
+						4*k*sizeof(GLfloat),4,FWE_INSTANCE_STRIDE*sizeof(GLfloat));
+					vertexAttribDivisor(instance_attribute+k,1);
+				}
+				shader->enableAttributeArray(identifier_attribute);
+				shader->setAttributeBuffer(identifier_attribute,GL_FLOAT,
+					16*sizeof(GLfloat),1,FWE_INSTANCE_STRIDE*sizeof(GLfloat));
+				vertexAttribDivisor(identifier_attribute,1);
+
+				//Single draw call per material
+				for (int j = 0; j < ranges.count(); j++) {
+					if (!outline) FWE_SetMaterial(ranges[j]);
+					drawElementsInstanced(GL_TRIANGLES,ranges[j].count,GL_UNSIGNED_INT,
+						(const GLvoid*)(ranges[j].offset*sizeof(GLuint)),batch->batch.transformations.count());
+				}
+
+				//Restore attribute state
+				for (int k = 0; k < 4; k++) {
+					vertexAttribDivisor(instance_attribute+k,0);
+					shader->disableAttributeArray(instance_attribute+k);
+				}
+				vertexAttribDivisor(identifier_attribute,0);
+				shader->disableAttributeArray(identifier_attribute);
+				batch->instanceBuffer.release();
+			} else {
+				//Draw copies one by one, per-copy data is passed as constant attributes
+				for (int j = 0; j < ranges.count(); j++) {
+					if (!outline) FWE_SetMaterial(ranges[j]);
+					for (int c = 0; c < batch->batch.transformations.count(); c++) {
+						const double* matrix = batch->batch.transformations[c].getData();
+						for (int k = 0; k < 4; k++) {
+							shader->setAttributeValue(instance_attribute+k,
+								(GLfloat)matrix[4*k+0],(GLfloat)matrix[4*k+1],(GLfloat)matrix[4*k+2],(GLfloat)matrix[4*k+3]);
+						}
+						shader->setAttributeValue(identifier_attribute,(GLfloat)batch->batch.identifiers[c]);
+						glDrawElements(GL_TRIANGLES,ranges[j].count,GL_UNSIGNED_INT,
+							(const GLvoid*)(ranges[j].offset*sizeof(GLuint)));
+					}
+				}
+			}
+
+			shader->disableAttributeArray(position_attribute);
+			shader->disableAttributeArray(normal_attribute);
+			mesh->indexBuffer.release();
+			mesh->normalBuffer.release();
+		}
+	}
+	shader->release();
+
+	glDisable(GL_VERTEX_PROGRAM_TWO_SIDE);
+	if (color_material) glEnable(GL_COLOR_MATERIAL);
+}
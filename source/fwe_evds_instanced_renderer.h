@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EVDS_INSTANCED_RENDERER_H
+#define FWE_EVDS_INSTANCED_RENDERER_H
+
+#include <QMap>
+#include <QList>
+#include <QVector>
+#include <QGLBuffer>
+#include <QGLShaderProgram>
+
+#include <GLC_Mesh>
+#include <GLC_3DRep>
+#include <GLC_Viewport>
+#include <GLC_BoundingBox>
+
+namespace EVDS {
+	class Object;
+
+	typedef void (APIENTRY *FWE_DrawElementsInstancedProc)(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices, GLsizei primcount);
+	typedef void (APIENTRY *FWE_VertexAttribDivisorProc)(GLuint index, GLuint divisor);
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Copies of a single representation, drawn with one instanced draw call
+	////////////////////////////////////////////////////////////////////////////////
+	struct InstancedBatch {
+		GLC_3DRep* representation; //Representation which is copied
+		QVector<GLC_Matrix4x4> transformations; //World transformations of the visible copies
+		QVector<GLC_uint> identifiers; //Identifiers written into outline buffer for every copy
+	};
+
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Mesh data uploaded for instanced rendering
+	////////////////////////////////////////////////////////////////////////////////
+	struct InstancedMesh {
+		struct Range {
+			int offset; //First index
+			int count; //Number of indices
+			//Material (same values GLC uses for the original object)
+			QColor ambient;
+			QColor diffuse;
+			QColor specular;
+			QColor emissive;
+			float shininess;
+		};
+
+		InstancedMesh();
+		~InstancedMesh();
+
+		//Upload vertices and indices of all LODs
+		void upload(GLC_Mesh* mesh);
+
+		QGLBuffer vertexBuffer;
+		QGLBuffer normalBuffer;
+		QGLBuffer indexBuffer;
+		QList<QList<Range> > lods;
+	};
+
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Renders many copies of the same representation with hardware instancing.
+	///
+	/// Each batch is culled against the view frustum by its aggregate bounding box. If
+	/// instancing is not supported by the driver, copies are drawn one by one from the
+	/// same buffers.
+	////////////////////////////////////////////////////////////////////////////////
+	class InstancedRenderer {
+	public:
+		InstancedRenderer();
+		~InstancedRenderer();
+
+		//Replace all batches created by the owner
+		void setBatches(Object* owner, const QList<InstancedBatch>& batches);
+		//Remove all batches created by the owner
+		void removeBatches(Object* owner);
+		//Mesh was changed or destroyed, it must be uploaded again
+		void invalidateMesh(GLC_Mesh* mesh);
+
+		//Aggregate bounding box of all copies
+		GLC_BoundingBox boundingBox();
+		//Are there any copies to draw
+		bool isEmpty() { return batches.isEmpty(); }
+		//Incremented every time copies or their meshes change
+		int getGeneration() { return generation; }
+
+		//Draw all copies (in outline mode identifiers are written instead of colors)
+		void render(QGLShaderProgram* shader, GLC_Viewport* viewport, bool outline, bool useLODs);
+
+	private:
+		struct Batch {
+			InstancedBatch batch;
+			GLC_Mesh* mesh;
+			QGLBuffer instanceBuffer; //Per-copy transformation and identifier
+			bool instanceBufferValid;
+			GLC_BoundingBox boundingBox;
+			bool boundingBoxValid;
+		};
+
+		//Compute aggregate bounding box of all copies
+		void updateBoundingBox(Batch* batch);
+		//Upload per-copy transformations and identifiers
+		void uploadBatch(Batch* batch);
+		//Select LOD by approximate size of a single copy on screen
+		int selectLOD(Batch* batch, GLC_Viewport* viewport, int lodCount);
+		//Resolve instancing entry points
+		void resolveExtensions();
+
+		QMap<Object*,QList<Batch*> > batches;
+		QMap<GLC_Mesh*,InstancedMesh*> meshes;
+		int generation;
+
+		bool extensionsResolved;
+		FWE_DrawElementsInstancedProc drawElementsInstanced;
+		FWE_VertexAttribDivisorProc vertexAttribDivisor;
+	};
+}
+
+#endif
@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#include "fwe_evds_mesh_scheduler.h"
+
+using namespace EVDS;
+
+MeshJobScheduler* MeshJobScheduler::scheduler = 0;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+MeshJobWorker::MeshJobWorker(MeshJobScheduler* in_scheduler, int in_index) {
+	scheduler = in_scheduler;
+	index = in_index;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void MeshJobWorker::push(MeshJob* job) {
+	queueLock.lock();
+		queue.append(job);
+	queueLock.unlock();
+}
+
+MeshJob* MeshJobWorker::pop() {
+	MeshJob* job = 0;
+	queueLock.lock();
+		if (!queue.isEmpty()) job = queue.takeLast();
+	queueLock.unlock();
+	return job;
+}
+
+MeshJob* MeshJobWorker::steal() {
+	MeshJob* job = 0;
+	queueLock.lock();
+		if (!queue.isEmpty()) job = queue.takeFirst();
+	queueLock.unlock();
+	return job;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void MeshJobWorker::run() {
+	MeshJob* job;
+	while ((job = scheduler->waitForJob(index))) {
+		job->run();
+		delete job;
+	}
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+MeshJobScheduler::MeshJobScheduler() {
+	pendingJobs = 0;
+	nextWorker = 0;
+	doStopWork = false;
+
+	//Create fixed number of workers
+	int worker_count = QThread::idealThreadCount();
+	if (worker_count < 1) worker_count = 1;
+	for (int i = 0; i < worker_count; i++) {
+		workers.append(new MeshJobWorker(this,i));
+	}
+	for (int i = 0; i < worker_count; i++) {
+		workers[i]->start(QThread::LowPriority);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+MeshJobScheduler::~MeshJobScheduler() {
+	idleLock.lock();
+		doStopWork = true;
+		idleCondition.wakeAll();
+	idleLock.unlock();
+
+	for (int i = 0; i < workers.count(); i++) {
+		workers[i]->wait();
+		delete workers[i];
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+MeshJobScheduler* MeshJobScheduler::instance() {
+	if (!scheduler) scheduler = new MeshJobScheduler();
+	return scheduler;
+}
+
+void MeshJobScheduler::shutdown() {
+	if (scheduler) delete scheduler;
+	scheduler = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Queue job for execution
+///
+/// Jobs submitted from a worker go to its own queue, all other jobs are spread
+/// between workers. Idle workers steal jobs from the queues of busy ones.
+////////////////////////////////////////////////////////////////////////////////
+void MeshJobScheduler::submit(MeshJob* job) {
+	int index = getCurrentWorker();
+	if (index < 0) {
+		idleLock.lock();
+			index = nextWorker;
+			nextWorker = (nextWorker + 1) % workers.count();
+		idleLock.unlock();
+	}
+	workers[index]->push(job);
+
+	idleLock.lock();
+		pendingJobs++;
+		idleCondition.wakeOne();
+	idleLock.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+MeshJob* MeshJobScheduler::findJob(int index) {
+	MeshJob* job = workers[index]->pop();
+	for (int i = 1; (!job) && (i < workers.count()); i++) {
+		job = workers[(index + i) % workers.count()]->steal();
+	}
+	return job;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+MeshJob* MeshJobScheduler::waitForJob(int index) {
+	while (true) {
+		MeshJob* job = findJob(index);
+		if (job) {
+			idleLock.lock();
+				pendingJobs--;
+			idleLock.unlock();
+			return job;
+		}
+
+		//Sleep until there is something to do
+		idleLock.lock();
+			while ((pendingJobs == 0) && (!doStopWork)) {
+				idleCondition.wait(&idleLock);
+			}
+			bool stopped = doStopWork && (pendingJobs == 0);
+		idleLock.unlock();
+		if (stopped) return 0;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+int MeshJobScheduler::getCurrentWorker() {
+	QThread* current = QThread::currentThread();
+	for (int i = 0; i < workers.count(); i++) {
+		if (workers[i] == current) return i;
+	}
+	return -1;
+}
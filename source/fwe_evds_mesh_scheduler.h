@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EVDS_MESH_SCHEDULER_H
+#define FWE_EVDS_MESH_SCHEDULER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QList>
+
+namespace EVDS {
+	class MeshJob {
+	public:
+		virtual ~MeshJob() { }
+
+		//Do the work (called from one of the scheduler worker threads)
+		virtual void run() = 0;
+	};
+
+
+	class MeshJobScheduler;
+	class MeshJobWorker : public QThread {
+	public:
+		MeshJobWorker(MeshJobScheduler* in_scheduler, int in_index);
+
+		//Push job into the private end of the queue
+		void push(MeshJob* job);
+		//Pop job from the private end of the queue (only called by the worker itself)
+		MeshJob* pop();
+		//Steal job from the public end of the queue (called by other workers)
+		MeshJob* steal();
+
+	protected:
+		void run();
+
+	private:
+		MeshJobScheduler* scheduler; //Scheduler this worker belongs to
+		int index; //Index of this worker in scheduler
+
+		QMutex queueLock; //Locked when queue is modified
+		QList<MeshJob*> queue; //Jobs queued for this worker
+	};
+
+
+	class MeshJobScheduler {
+	public:
+		//Get process-wide scheduler (created on first use)
+		static MeshJobScheduler* instance();
+		//Finish all queued jobs, stop workers and destroy the scheduler
+		static void shutdown();
+
+		//Queue job for execution. Scheduler takes ownership of the job
+		void submit(MeshJob* job);
+		//Get number of worker threads
+		int getWorkerCount() { return workers.count(); }
+
+	private:
+		friend class MeshJobWorker;
+		MeshJobScheduler();
+		~MeshJobScheduler();
+
+		//Get job from own queue, or steal one from other workers
+		MeshJob* findJob(int index);
+		//Block worker until there is a job for it (returns 0 when scheduler is stopped)
+		MeshJob* waitForJob(int index);
+		//Find index of the worker running in the current thread (-1 if not a worker)
+		int getCurrentWorker();
+
+		QVector<MeshJobWorker*> workers;
+		int nextWorker; //Worker which receives next job submitted from outside
+
+		QMutex idleLock; //Protects pendingJobs and doStopWork
+		QWaitCondition idleCondition; //Signalled when new job is queued or scheduler stops
+		int pendingJobs; //Number of jobs queued but not yet taken by workers
+		bool doStopWork; //Stop workers once all queues are empty
+
+		static MeshJobScheduler* scheduler;
+	};
+}
+
+#endif
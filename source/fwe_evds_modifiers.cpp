@@ -31,11 +31,142 @@
 #include "fwe_evds_object.h"
 #include "fwe_evds_object_renderer.h"
 #include "fwe_evds_glscene.h"
+#include "fwe_evds_instanced_renderer.h"
 #include "fwe_evds_modifiers.h"
 
 using namespace EVDS;
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Names of modifier variables
+////////////////////////////////////////////////////////////////////////////////
+static const VariableName var_vector1_count("vector1.count");
+static const VariableName var_vector2_count("vector2.count");
+static const VariableName var_vector3_count("vector3.count");
+static const VariableName var_circular_step("circular.step");
+static const VariableName var_circular_radial_step("circular.radial_step");
+static const VariableName var_circular_normal_step("circular.normal_step");
+static const VariableName var_circular_arc_length("circular.arc_length");
+static const VariableName var_circular_radius("circular.radius");
+static const VariableName var_circular_rotate("circular.rotate");
+static const VariableName var_vector1_x("vector1.x");
+static const VariableName var_vector1_y("vector1.y");
+static const VariableName var_vector1_z("vector1.z");
+static const VariableName var_vector2_x("vector2.x");
+static const VariableName var_vector2_y("vector2.y");
+static const VariableName var_vector2_z("vector2.z");
+static const VariableName var_vector3_x("vector3.x");
+static const VariableName var_vector3_y("vector3.y");
+static const VariableName var_vector3_z("vector3.z");
+static const VariableName var_pattern("pattern");
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read modifier parameters and expand the pattern.
+///
+/// Basis of the pattern (circle axes, per-step sines and cosines, rotations) is
+/// computed once, only additions remain in the inner loop.
+////////////////////////////////////////////////////////////////////////////////
+ModifierPattern::ModifierPattern(Object* modifier) {
+	//Get modifier information
+	int vector1_count = modifier->getVariable(var_vector1_count);
+	int vector2_count = modifier->getVariable(var_vector2_count);
+	int vector3_count = modifier->getVariable(var_vector3_count);
+	float circular_step = modifier->getVariable(var_circular_step);
+	float circular_radial_step = modifier->getVariable(var_circular_radial_step);
+	float circular_normal_step = modifier->getVariable(var_circular_normal_step);
+	float circular_arc_length = modifier->getVariable(var_circular_arc_length);
+	float circular_radius = modifier->getVariable(var_circular_radius);
+	float circular_rotate = modifier->getVariable(var_circular_rotate);
+	bool circular_pattern = modifier->getString(var_pattern) == "circular";
+	QVector3D vector1 = QVector3D(
+		modifier->getVariable(var_vector1_x),
+		modifier->getVariable(var_vector1_y),
+		modifier->getVariable(var_vector1_z));
+	QVector3D vector2 = QVector3D(
+		modifier->getVariable(var_vector2_x),
+		modifier->getVariable(var_vector2_y),
+		modifier->getVariable(var_vector2_z));
+	QVector3D vector3 = QVector3D(
+		modifier->getVariable(var_vector3_x),
+		modifier->getVariable(var_vector3_y),
+		modifier->getVariable(var_vector3_z));
+
+	//Make sure master copy remains
+	if (vector1_count < 1) vector1_count = 1;
+	if (vector2_count < 1) vector2_count = 1;
+	if (vector3_count < 1) vector3_count = 1;
+	transformations.reserve(vector1_count*vector2_count*vector3_count);
+
+	//Fix modifier parameters just like the EVDS does
+	if (circular_step == 0.0) {
+		if (circular_arc_length == 0.0) circular_arc_length = 360.0;
+		circular_step = circular_arc_length / ((double)vector1_count);
+	}
+
+	if (circular_pattern) {
+		//Get circle parameters
+		QVector3D normal = vector1;
+		QVector3D direction = vector2;
+		if (normal.length() == 0.0) normal.setX(1.0);
+		if (direction.length() == 0.0) direction.setZ(1.0);
+		normal.normalize();
+		direction.normalize();
+
+		//Local coordinate system
+		QVector3D u = -direction;
+		QVector3D v = QVector3D::crossProduct(direction,normal);
+		QVector3D center = direction*circular_radius;
+		QVector3D normal_step = normal*circular_normal_step;
+
+		//Position on circle and rotation for every step along the circle
+		QVector<QVector3D> radial(vector1_count);
+		QVector<GLC_Matrix4x4> rotation(vector1_count);
+		for (int i = 0; i < vector1_count; i++) {
+			double angle = EVDS_RAD(i * circular_step);
+			radial[i] = u*cos(angle) + v*sin(angle);
+			if (circular_rotate > 0.5) {
+				rotation[i] = GLC_Matrix4x4(GLC_Vector3d(normal.x(),normal.y(),normal.z()), angle);
+			}
+		}
+
+		for (int i = 0; i < vector1_count; i++) {
+			//Do not generate first object is radius is non-zero
+			if ((circular_radius != 0.0) && (i == 0)) continue;
+			for (int j = 0; j < vector2_count; j++) {
+				//Do not generate first ring if radius is zero (only concentric objects)
+				if ((circular_radius == 0.0) && (j == 0)) continue;
+				QVector3D ring_offset = center + radial[i]*(circular_radius + j*circular_radial_step);
+
+				for (int k = 0; k < vector3_count; k++) {
+					QVector3D offset = ring_offset + normal_step*k;
+					if (circular_rotate > 0.5) {
+						transformations.append(GLC_Matrix4x4(offset.x(),offset.y(),offset.z()) * rotation[i]);
+					} else {
+						transformations.append(GLC_Matrix4x4(offset.x(),offset.y(),offset.z()));
+					}
+				}
+			}
+		}
+	} else {
+		for (int i = 0; i < vector1_count; i++) {
+			for (int j = 0; j < vector2_count; j++) {
+				QVector3D row_offset = vector1*i + vector2*j;
+				for (int k = 0; k < vector3_count; k++) {
+					//Skip the first part of the matrix
+					if ((i == 0) && (j == 0) && (k == 0)) continue;
+
+					QVector3D offset = row_offset + vector3*k;
+					GLC_Matrix4x4 transformation;
+					transformation.setMatTranslate(offset.x(),offset.y(),offset.z());
+					transformations.append(transformation);
+				}
+			}
+		}
+	}
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -43,10 +174,8 @@ ObjectModifiersManager::ObjectModifiersManager(Editor* in_editor) {
 	editor = in_editor;
 	initializing = false;
 	shouldUpdateModifiers = false;
-
-	QTimer *timer = new QTimer(this);
-	connect(timer, SIGNAL(timeout()), this, SLOT(doUpdateModifiers()));
-	timer->start(10);
+	shouldUpdateAllModifiers = false;
+	shouldUpdatePositions = false;
 }
 
 
@@ -70,30 +199,58 @@ ObjectModifiersManager::~ObjectModifiersManager() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectModifiersManager::updateModifiers() {
-	GLScene* glview = editor->getGLScene();
-
 	//Remove all instances from glview
-	QMapIterator<Object*,QList<ObjectRendererModifierInstance> > iterator(modifierInstances);
-	while (iterator.hasNext()) {
-		iterator.next();
-		for (int i = 0; i < iterator.value().count(); i++) {
-			if (glview->getCollection()->contains(iterator.value()[i].instance->id())) {
-				glview->getCollection()->remove(iterator.value()[i].instance->id());
-			}
-			delete iterator.value()[i].instance;
-		}
-		iterator.value();
+	while (!modifierInstances.isEmpty()) {
+		removeInstances(modifierInstances.begin().key());
 	}
-	modifierInstances.clear();
+	invalidatedModifiers.clear();
 
 	//Run update routine
 	shouldUpdateModifiers = true;
+	shouldUpdateAllModifiers = true;
+	editor->scheduleUpdate();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Invalidate all modifiers whose instances depend on the given object.
+///
+/// Instances of the invalidated modifiers are removed right away (they may refer
+/// to instances of removed objects), and are re-created on the next update.
+////////////////////////////////////////////////////////////////////////////////
+void ObjectModifiersManager::invalidateModifiers(Object* object) {
+	while (object) {
+		if ((object->getTypeID() == Object::TYPE_MODIFIER) || modifierInstances.contains(object)) {
+			removeInstances(object);
+			invalidatedModifiers.insert(object);
+		}
+		object = object->getParent();
+	}
+	shouldUpdateModifiers = true;
+	editor->scheduleUpdate();
 }
 
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectModifiersManager::removeInstances(Object* modifier) {
+	editor->getGLScene()->getInstancedRenderer()->removeBatches(modifier);
+
+	QList<ObjectRendererModifierInstance> instances = modifierInstances.take(modifier);
+	for (int i = 0; i < instances.count(); i++) {
+		delete instances[i].instance;
+	}
+}
+
+
 void ObjectModifiersManager::doUpdateModifiers() {
 	if (!shouldUpdateModifiers) return;
 	shouldUpdateModifiers = false;
 
+	//Base instances must be in their final positions
+	editor->updateTransformations();
+
 	//GLScene* glview = editor->getGLScene();
 
 	qDebug("ObjectModifiersManager::updateModifiers()");
@@ -113,10 +270,12 @@ void ObjectModifiersManager::doUpdateModifiers() {
 	modifierInstances.clear();*/
 
 	//Process all object starting from root
-	processUpdateModifiers(editor->getEditRoot());
-
-	//Update GL scene
-	editor->getGLScene()->update();
+	if (shouldUpdateAllModifiers || (!invalidatedModifiers.isEmpty())) {
+		processUpdateModifiers(editor->getEditRoot());
+		editor->getGLScene()->invalidateGeometry();
+	}
+	shouldUpdateAllModifiers = false;
+	invalidatedModifiers.clear();
 }
 
 
@@ -129,16 +288,21 @@ void ObjectModifiersManager::processUpdateModifiers(Object* object) {
 		processUpdateModifiers(object->getChild(i));
 	}
 
+	//Instances of modifiers which were not changed are kept
+	if ((!shouldUpdateAllModifiers) && (!invalidatedModifiers.contains(object))) return;
+
 	//If object is a modifier, create copies of its children
-	if (object->getType() == "modifier") {
+	if (object->getTypeID() == Object::TYPE_MODIFIER) {
+		ModifierPattern pattern(object);
 		for (int i = 0; i < object->getChildrenCount(); i++) {
-			createModifiedCopy(object,object->getChild(i));
+			createModifiedCopy(object,object->getChild(i),pattern);
 		}
 
 		//Set positions of all children
 		for (int i = 0; i < modifierInstances[object].count(); i++) {
 			setInstancePosition(&modifierInstances[object][i]);
 		}
+		updateBatches(object);
 	}
 }
 
@@ -153,10 +317,11 @@ void ObjectModifiersManager::processUpdatePosition(Object* object) {
 	}
 
 	//Set positions of all children
-	if (object->getType() == "modifier") {
+	if (object->getTypeID() == Object::TYPE_MODIFIER) {
 		for (int i = 0; i < modifierInstances[object].count(); i++) {
 			setInstancePosition(&modifierInstances[object][i]);
 		}
+		updateBatches(object);
 	}
 }
 
@@ -179,144 +344,89 @@ void ObjectModifiersManager::setInstancePosition(ObjectRendererModifierInstance*
 
 	//Update visibility of this object
 	modifier_instance->instance->setVisibility(modifier_instance->real_base_instance->isVisible());
+}
 
-	//Add/replace to update position
-	GLScene* glview = editor->getGLScene();
-	if (glview->getCollection()->contains(modifier_instance->instance->id())) {
-		glview->getCollection()->remove(modifier_instance->instance->id());
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Group visible copies of the modifier by representation.
+///
+/// Copies are not added to the GL collection, every group is drawn by a single
+/// instanced draw call.
+////////////////////////////////////////////////////////////////////////////////
+void ObjectModifiersManager::updateBatches(Object* modifier) {
+	QList<InstancedBatch> batches;
+	QHash<GLC_3DRep*,int> batch_index;
+
+	QList<ObjectRendererModifierInstance>& instances = modifierInstances[modifier];
+	for (int i = 0; i < instances.count(); i++) {
+		if (!instances[i].instance->isVisible()) continue;
+
+		GLC_3DRep* representation = instances[i].base_representation;
+		if (!batch_index.contains(representation)) {
+			InstancedBatch batch;
+			batch.representation = representation;
+			batch_index[representation] = batches.count();
+			batches.append(batch);
+		}
+
+		InstancedBatch& batch = batches[batch_index[representation]];
+		batch.transformations.append(instances[i].instance->matrix());
+		batch.identifiers.append(instances[i].instance->id());
 	}
-	glview->getCollection()->add(*modifier_instance->instance);
+	editor->getGLScene()->getInstancedRenderer()->setBatches(modifier,batches);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void ObjectModifiersManager::createModifiedCopy(Object* modifier, Object* object) {
-	//Get modifier information
-	int vector1_count = modifier->getVariable("vector1.count");
-	int vector2_count = modifier->getVariable("vector2.count");
-	int vector3_count = modifier->getVariable("vector3.count");
-	float circular_step = modifier->getVariable("circular.step");
-	float circular_radial_step = modifier->getVariable("circular.radial_step");
-	float circular_normal_step = modifier->getVariable("circular.normal_step");
-	float circular_arc_length = modifier->getVariable("circular.arc_length");
-	float circular_radius = modifier->getVariable("circular.radius");
-	float circular_rotate = modifier->getVariable("circular.rotate");
-	QVector3D vector1 = QVector3D(
-		modifier->getVariable("vector1.x"),
-		modifier->getVariable("vector1.y"),
-		modifier->getVariable("vector1.z"));
-	QVector3D vector2 = QVector3D(
-		modifier->getVariable("vector2.x"),
-		modifier->getVariable("vector2.y"),
-		modifier->getVariable("vector2.z"));
-	QVector3D vector3 = QVector3D(
-		modifier->getVariable("vector3.x"),
-		modifier->getVariable("vector3.y"),
-		modifier->getVariable("vector3.z"));
-
-	//Make sure master copy remains
-	if (vector1_count < 1) vector1_count = 1;
-	if (vector2_count < 1) vector2_count = 1;
-	if (vector3_count < 1) vector3_count = 1;
-
-	//Fix modifier parameters just like the EVDS does
-	if (circular_step == 0.0) {
-		if (circular_arc_length == 0.0) circular_arc_length = 360.0;
-		circular_step = circular_arc_length / ((double)vector1_count);
+void ObjectModifiersManager::createModifiedCopy(Object* modifier, Object* object, const ModifierPattern& pattern) {
+	const QVector<GLC_Matrix4x4>& transformations = pattern.getTransformations();
+	QList<ObjectRendererModifierInstance>& instances = modifierInstances[modifier];
+	GLC_3DViewInstance* modifier_instance = modifier->getRenderer()->getInstance();
+	GLC_3DViewInstance* object_instance = object->getRenderer()->getInstance();
+	GLC_3DRep* object_representation = object->getRenderer()->getRepresentation();
+
+	//Instances of the nested modifier are copied too
+	QList<ObjectRendererModifierInstance> nested_instances;
+	if ((object->getTypeID() == Object::TYPE_MODIFIER) && (object != modifier)) {
+		nested_instances = modifierInstances.value(object);
 	}
 
 	//Add instances as moved by modifier
-	for (int i = 0; i < vector1_count; i++) {
-		for (int j = 0; j < vector2_count; j++) {
-			for (int k = 0; k < vector3_count; k++) {
-				//Create transformation
-				GLC_Matrix4x4 transformation;
-				if (modifier->getString("pattern") == "circular") {
-					//Get circle parameters
-					QVector3D normal = vector1;
-					QVector3D direction = vector2;
-					if (normal.length() == 0.0) normal.setX(1.0);
-					if (direction.length() == 0.0) direction.setZ(1.0);
-					normal.normalize();
-					direction.normalize();
-
-					//Do not generate first ring if radius is zero (only concentric objects)
-					if ((circular_radius == 0.0) && (j == 0)) continue;
-					//Do not generate first object is radius is non-zero
-					if ((circular_radius != 0.0) && (i == 0)) continue;
-
-					//Local coordinate system
-					QVector3D u = -direction;
-					QVector3D v = normal.crossProduct(direction,normal);
-
-					//Get point on circle
-					double x = (circular_radius + j*circular_radial_step)*cos(EVDS_RAD(i * circular_step));
-					double y = (circular_radius + j*circular_radial_step)*sin(EVDS_RAD(i * circular_step));
-					QVector3D offset = direction*circular_radius + u*x + v*y + normal*circular_normal_step*k;
-
-					//Generate transformation
-					if (circular_rotate > 0.5) {
-						transformation = 
-							GLC_Matrix4x4(offset.x(),offset.y(),offset.z()) *
-							GLC_Matrix4x4(GLC_Vector3d(normal.x(),normal.y(),normal.z()), EVDS_RAD(i * circular_step));
-					} else {
-						transformation = 
-							//GLC_Matrix4x4(GLC_Vector3d(normal.x(),normal.y(),normal.z()), EVDS_RAD(i * circular_step)) * 
-							GLC_Matrix4x4(offset.x(),offset.y(),offset.z());
-					}						
-				} else {
-					QVector3D offset = vector1*i + vector2*j + vector3*k;
-					transformation.setMatTranslate(offset.x(),offset.y(),offset.z());
-
-					//Skip the first part of the matrix
-					if ((i == 0) && (j == 0) && (k == 0)) continue;
-				}
-
-
-				//Create copy of the child itself
-				ObjectRendererModifierInstance modifier_inst;
-				modifier_inst.modifier_instance = modifier->getRenderer()->getInstance();
-				modifier_inst.base_instance = object->getRenderer()->getInstance();
-				modifier_inst.real_base_instance = object->getRenderer()->getInstance();
-				modifier_inst.base_representation = object->getRenderer()->getRepresentation();
-				modifier_inst.instance = new GLC_3DViewInstance(*modifier_inst.base_representation);
-				modifier_inst.transformation = transformation;
-
-				//Add instance to scene
-				editor->getGLScene()->getCollection()->add(*modifier_inst.instance);
-
-				//Append instance
-				modifierInstances[modifier].append(modifier_inst);
-
-				//Copy modifiers instances of the child to this modifier
-				if ((object->getType() == "modifier") && (object != modifier)) {
-					for (int j = 0; j < modifierInstances[object].count(); j++) {
-						ObjectRendererModifierInstance modifier_inst;
-						//Use the modified instance instead of original base instance
-						modifier_inst.modifier_instance = modifier->getRenderer()->getInstance();
-						modifier_inst.base_instance = modifierInstances[object][j].instance;
-						modifier_inst.real_base_instance = modifierInstances[object][j].real_base_instance;
-						modifier_inst.base_representation = modifierInstances[object][j].base_representation;
-						modifier_inst.instance = new GLC_3DViewInstance(*modifier_inst.base_representation);
-						modifier_inst.transformation = transformation;
-
-						//Add instance to scene
-						editor->getGLScene()->getCollection()->add(*modifier_inst.instance);
-
-						//Remember instance
-						modifierInstances[modifier].append(modifier_inst);
-					}
-				}
-			}
+	for (int t = 0; t < transformations.count(); t++) {
+		//Create copy of the child itself
+		ObjectRendererModifierInstance modifier_inst;
+		modifier_inst.modifier_instance = modifier_instance;
+		modifier_inst.base_instance = object_instance;
+		modifier_inst.real_base_instance = object_instance;
+		modifier_inst.base_representation = object_representation;
+		modifier_inst.instance = new GLC_3DViewInstance(*modifier_inst.base_representation);
+		modifier_inst.transformation = transformations[t];
+
+		//Append instance
+		instances.append(modifier_inst);
+
+		//Copy modifiers instances of the child to this modifier
+		for (int j = 0; j < nested_instances.count(); j++) {
+			ObjectRendererModifierInstance modifier_inst;
+			//Use the modified instance instead of original base instance
+			modifier_inst.modifier_instance = modifier_instance;
+			modifier_inst.base_instance = nested_instances[j].instance;
+			modifier_inst.real_base_instance = nested_instances[j].real_base_instance;
+			modifier_inst.base_representation = nested_instances[j].base_representation;
+			modifier_inst.instance = new GLC_3DViewInstance(*modifier_inst.base_representation);
+			modifier_inst.transformation = transformations[t];
+
+			//Remember instance
+			instances.append(modifier_inst);
 		}
 	}
 
 	//Create copies of the modifiers children (not included in modifiers instances)
 	//if ((object->getType() == "modifier") && (object != modifier)) {
 		for (int i = 0; i < object->getChildrenCount(); i++) {
-			createModifiedCopy(modifier,object->getChild(i));
+			createModifiedCopy(modifier,object->getChild(i),pattern);
 		}
 	//}
 }
@@ -328,17 +438,28 @@ void ObjectModifiersManager::createModifiedCopy(Object* modifier, Object* object
 void ObjectModifiersManager::objectPositionChanged(Object* object) {
 	if (!initializing) {
 		//updateModifiers();
-		processUpdatePosition(editor->getEditRoot());
+		shouldUpdatePositions = true;
 	}
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Called by editor after transformations of the moved objects were updated
+////////////////////////////////////////////////////////////////////////////////
+void ObjectModifiersManager::updatePositions() {
+	if (!shouldUpdatePositions) return;
+	shouldUpdatePositions = false;
+
+	processUpdatePosition(editor->getEditRoot());
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectModifiersManager::modifierChanged(Object* object) {
 	//if (object->getType() == "modifier")
-	if (!initializing) updateModifiers();
+	if (!initializing) invalidateModifiers(object);
 }
 
 
@@ -346,7 +467,23 @@ void ObjectModifiersManager::modifierChanged(Object* object) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectModifiersManager::objectRemoved(Object* object) {
-	if (!initializing) updateModifiers();
+	//Object must not be referenced anymore
+	removeInstances(object);
+	invalidatedModifiers.remove(object);
+	if (initializing) return;
+
+	//Update modifiers which contained the object (EVDS object may already be destroyed,
+	//so only modifiers known to the manager are checked)
+	Object* parent = object->getParent();
+	while (parent) {
+		if (modifierInstances.contains(parent) || invalidatedModifiers.contains(parent)) {
+			removeInstances(parent);
+			invalidatedModifiers.insert(parent);
+			shouldUpdateModifiers = true;
+			editor->scheduleUpdate();
+		}
+		parent = parent->getParent();
+	}
 }
 
 
@@ -354,5 +491,5 @@ void ObjectModifiersManager::objectRemoved(Object* object) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectModifiersManager::objectAdded(Object* object) {
-	if (!initializing) updateModifiers();
+	if (!initializing) invalidateModifiers(object);
 }
@@ -30,6 +30,8 @@
 #define FWE_EVDS_MODIFIERS_H
 
 #include <QThread>
+#include <QSet>
+#include <QVector>
 
 #include <GLC_Mesh>
 #include <GLC_3DViewInstance>
@@ -47,6 +49,24 @@ namespace EVDS {
 		GLC_3DRep* base_representation; //3D representation of the original object
 		GLC_Matrix4x4 transformation; //Modifiers transformation
 	};
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Transformations of all copies created by a modifier.
+	///
+	/// Pattern is expanded once per modifier and shared by all of its children.
+	////////////////////////////////////////////////////////////////////////////////
+	class ModifierPattern {
+	public:
+		//Read modifier parameters and expand the pattern
+		ModifierPattern(Object* modifier);
+
+		//Transformations of the copies, in modifiers local coordinates (original is not included)
+		const QVector<GLC_Matrix4x4>& getTransformations() const { return transformations; }
+
+	private:
+		QVector<GLC_Matrix4x4> transformations;
+	};
+
 	class ObjectModifiersManager : public QObject
 	{
 		Q_OBJECT
@@ -57,12 +77,16 @@ namespace EVDS {
 
 		//Update all modifiers
 		void updateModifiers();
+		//Update modifiers which contain the given object (or the object itself, if it's a modifier)
+		void invalidateModifiers(Object* object);
 		//Object was removed - make sure all modifiers are updated accordingly
 		void objectRemoved(Object* object);
 		//Object was added - make sure all modifiers are updated accordingly
 		void objectAdded(Object* object);
-		//Update position of all instances of the modified object
+		//Position of all instances of the modified object must be updated
 		void objectPositionChanged(Object* object);
+		//Update positions of all instances (if any object was moved)
+		void updatePositions();
 		//Update modifier object parameters
 		void modifierChanged(Object* object);
 
@@ -74,7 +98,7 @@ namespace EVDS {
 		//Get modifier instances
 		QList<ObjectRendererModifierInstance>& getInstances(Object* object) { return modifierInstances[object]; }
 
-	private slots:
+		//Re-create instances of the invalidated modifiers (called from editors scheduled update)
 		void doUpdateModifiers();
 
 	private:
@@ -83,10 +107,15 @@ namespace EVDS {
 		//Updates positions of all things
 		void processUpdatePosition(Object* object);
 
+		//Removes instances created by the modifier
+		void removeInstances(Object* modifier);
+
 		//Creates a modified copy from the given object
-		void createModifiedCopy(Object* modifier, Object* object);
+		void createModifiedCopy(Object* modifier, Object* object, const ModifierPattern& pattern);
 		//Sets position of the modified instance
 		void setInstancePosition(ObjectRendererModifierInstance* modifier_instance);
+		//Pass visible copies of the modifier to the instanced renderer
+		void updateBatches(Object* modifier);
 
 		//Instances created by modifier
 		QMap<Object*,QList<ObjectRendererModifierInstance> > modifierInstances;
@@ -97,6 +126,12 @@ namespace EVDS {
 		bool initializing;
 		//Should modifiers be updated
 		bool shouldUpdateModifiers;
+		//Should all modifiers be updated (otherwise only the invalidated ones)
+		bool shouldUpdateAllModifiers;
+		//Modifiers which must be updated
+		QSet<Object*> invalidatedModifiers;
+		//Should instance positions be updated
+		bool shouldUpdatePositions;
 	};
 }
 
@@ -29,6 +29,7 @@
 //#include <QtGui>
 #include <QString>
 #include <math.h>
+#include <string.h>
 
 #include "fwe_evds.h"
 #include "fwe_evds_object.h"
@@ -42,6 +43,33 @@
 using namespace EVDS;
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+VariableName::VariableName(const char* in_name) {
+	intern(QByteArray(in_name));
+}
+
+VariableName::VariableName(const QString &in_name) {
+	intern(in_name.toUtf8());
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Find name in the table of interned names (or add it there)
+////////////////////////////////////////////////////////////////////////////////
+void VariableName::intern(const QByteArray &utf8_name) {
+	static QMutex names_lock;
+	static QHash<QByteArray,QByteArray> names;
+
+	names_lock.lock();
+		QHash<QByteArray,QByteArray>::iterator i = names.find(utf8_name);
+		if (i == names.end()) i = names.insert(utf8_name,utf8_name);
+		name = i.value().constData();
+	names_lock.unlock();
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -51,6 +79,7 @@ Object::Object(EVDS_OBJECT* in_object, EVDS::Object* in_parent, EVDS::Editor* in
 	editor = in_editor;
 	parent = in_parent;
 	schematics_editor = in_schematics_editor;
+	type_valid = false;
 
 	//Get editor from parent
 	if (parent) {
@@ -347,7 +376,7 @@ QString Object::getName() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::setName(const QString &name) {
-	editor->setModified();
+	editor->setModified(this);
 	EVDS_Object_SetName(object,name.toUtf8().data());
 	update(false);
 }
@@ -357,9 +386,37 @@ void Object::setName(const QString &name) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 QString Object::getType() {
-	char type[257] = { 0 };
-	EVDS_Object_GetType(object,type,256);
-	return QString(type);
+	if (!type_valid) updateType();
+	return type;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read type from EVDS object and find out its identifier
+////////////////////////////////////////////////////////////////////////////////
+void Object::updateType() {
+	char type_str[257] = { 0 };
+	EVDS_Object_GetType(object,type_str,256);
+	type = QString(type_str);
+	type_valid = true;
+
+	if (type == "metadata") {
+		type_id = TYPE_METADATA;
+	} else if (type == "modifier") {
+		type_id = TYPE_MODIFIER;
+	} else if (type == "fuel_tank") {
+		type_id = TYPE_FUEL_TANK;
+	} else if (type == "rocket_engine") {
+		type_id = TYPE_ROCKET_ENGINE;
+	} else if (type == "foxworks.schematics") {
+		type_id = TYPE_SCHEMATICS;
+	} else if (type == "foxworks.schematics.sheet") {
+		type_id = TYPE_SCHEMATICS_SHEET;
+	} else if (type == "foxworks.schematics.element") {
+		type_id = TYPE_SCHEMATICS_ELEMENT;
+	} else {
+		type_id = TYPE_OTHER;
+	}
 }
 
 
@@ -367,8 +424,9 @@ QString Object::getType() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::setType(const QString &type) {
-	editor->setModified();
+	editor->setModified(this);
 	EVDS_Object_SetType(object,type.toUtf8().data());
+	type_valid = false;
 	update(false);
 
 	editor->getModifiersManager()->modifierChanged(this);
@@ -410,10 +468,10 @@ QWidget* Object::getPropertySheet() {
 				this, SLOT(propertyUpdate(const QString&)));
 
 		//Create default set of properties FIXME: make it less of a hack
-		if ((getType() != "metadata") && (!schematics_editor)) {
+		if ((getTypeID() != TYPE_METADATA) && (!schematics_editor)) {
 			property_sheet->setProperties(editor->objectVariables[""]);
 		}
-		if (schematics_editor && (getType() != "foxworks.schematics.sheet")) {
+		if (schematics_editor && (getTypeID() != TYPE_SCHEMATICS_SHEET)) {
 			property_sheet->setProperties(editor->objectVariables["foxworks.schematics"]);
 		}
 		if (!getType().isEmpty()) property_sheet->setProperties(editor->objectVariables[getType()]);
@@ -455,48 +513,63 @@ void Object::propertyUpdate(const QString& name) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::setVariable(const QString &name, double value) {
-	editor->setModified();
+	if (name[0] != '@') {
+		setVariable(VariableName(name),value);
+		return;
+	}
+	editor->setModified(this);
+
+	int specialIndex = name.right(1).toInt();
+	EVDS_STATE_VECTOR vector;
+	EVDS_REAL pitch,yaw,roll;
+	EVDS_Object_GetStateVector(object,&vector);
+
+	property_sheet->hackPitchYawRoll(&pitch,&yaw,&roll); //Get PYR from UI
+	pitch = EVDS_RAD(pitch);
+	yaw = EVDS_RAD(yaw);
+	roll = EVDS_RAD(roll);
+
+	switch (specialIndex) {
+		case 1: vector.position.x = value; break;
+		case 2: vector.position.y = value; break;
+		case 3: vector.position.z = value; break;
+		case 4: pitch = EVDS_RAD(value); break;
+		case 5: yaw = EVDS_RAD(value); break;
+		case 6: roll = EVDS_RAD(value); break;
+		case 8: EVDS_Object_SetUID(object,(unsigned int)value); break;
+	}
+	EVDS_Quaternion_FromEuler(&vector.orientation,vector.orientation.coordinate_system,roll,pitch,yaw);
+	EVDS_Object_SetStateVector(object,&vector);
+	update(false);
+}
 
-	if (name[0] == '@') {
-		int specialIndex = name.right(1).toInt();
-		EVDS_STATE_VECTOR vector;
-		EVDS_REAL pitch,yaw,roll;
-		EVDS_Object_GetStateVector(object,&vector);
 
-		property_sheet->hackPitchYawRoll(&pitch,&yaw,&roll); //Get PYR from UI
-		pitch = EVDS_RAD(pitch);
-		yaw = EVDS_RAD(yaw);
-		roll = EVDS_RAD(roll);
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void Object::setVariable(const VariableName &name, double value) {
+	//Variables which do not change geometry of the object
+	static const VariableName non_geometry_variables[] = {
+		VariableName("disable"),
+		VariableName("mass"),
+		VariableName("ixx"),
+		VariableName("iyy"),
+		VariableName("izz"),
+		VariableName("jxx"),
+		VariableName("jyy"),
+		VariableName("jzz"),
+	};
+	editor->setModified(this);
 
-		switch (specialIndex) {
-			case 1: vector.position.x = value; break;
-			case 2: vector.position.y = value; break;
-			case 3: vector.position.z = value; break;
-			case 4: pitch = EVDS_RAD(value); break;
-			case 5: yaw = EVDS_RAD(value); break;
-			case 6: roll = EVDS_RAD(value); break;
-			case 8: EVDS_Object_SetUID(object,(unsigned int)value); break;
-		}
-		EVDS_Quaternion_FromEuler(&vector.orientation,vector.orientation.coordinate_system,roll,pitch,yaw);
-		EVDS_Object_SetStateVector(object,&vector);
-		update(false);
-	} else {
-		EVDS_VARIABLE* variable;
-		EVDS_Object_AddRealVariable(object,name.toAscii().data(),value,&variable);
-		EVDS_Variable_SetReal(variable,value);
-		if ((name == "disable") ||
-			(name == "mass") ||
-			(name == "ixx") ||
-			(name == "iyy") ||
-			(name == "izz") ||
-			(name == "jxx") ||
-			(name == "jyy") ||
-			(name == "jzz")) {
-			update(false);
-		} else {
-			update(true);
-		}
+	EVDS_VARIABLE* variable;
+	EVDS_Object_AddRealVariable(object,name.data(),value,&variable);
+	EVDS_Variable_SetReal(variable,value);
+
+	bool visually = true;
+	for (unsigned int i = 0; i < sizeof(non_geometry_variables)/sizeof(non_geometry_variables[0]); i++) {
+		if (name == non_geometry_variables[i]) visually = false;
 	}
+	update(visually);
 }
 
 
@@ -504,7 +577,7 @@ void Object::setVariable(const QString &name, double value) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::setVariable(const QString &name, const QString &value) {
-	editor->setModified(name != "comments");
+	editor->setModified(this,name != "comments");
 
 	if (name[0] == '@') {
 		int specialIndex = name.right(1).toInt();
@@ -608,6 +681,57 @@ bool Object::isVariableDefined(const QString &name) {
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+double Object::getVariable(const VariableName &name) {
+	EVDS_VARIABLE* variable;
+	if (EVDS_Object_GetVariable(object,name.data(),&variable) == EVDS_OK) {
+		EVDS_REAL value;
+		EVDS_Variable_GetReal(variable,&value);
+		return value;
+	}
+	return 0.0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QString Object::getString(const VariableName &name) {
+	EVDS_VARIABLE* variable;
+	if (EVDS_Object_GetVariable(object,name.data(),&variable) == EVDS_OK) {
+		char str[8192] = { 0 };
+		EVDS_Variable_GetString(variable,str,8191,0);
+		return QString(str);
+	}
+	return QString();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QVector3D Object::getVector(const VariableName &name) {
+	EVDS_VARIABLE* variable;
+	if (EVDS_Object_GetVariable(object,name.data(),&variable) == EVDS_OK) {
+		EVDS_VECTOR value;
+		EVDS_Variable_GetVector(variable,&value);
+		return QVector3D(value.x,value.y,value.z);
+	}
+	return QVector3D();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+bool Object::isVariableDefined(const VariableName &name) {
+	EVDS_VARIABLE* variable;
+	return EVDS_Object_GetVariable(object,name.data(),&variable) == EVDS_OK;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -699,12 +823,12 @@ void Object::deleteCrossSectionsEditor() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void Object::update(bool visually) {
-	if (getType() == "metadata") return; //Do not do any updates for metadata
+	if (getTypeID() == TYPE_METADATA) return; //Do not do any updates for metadata
 
 	if (renderer) {
 		if (visually) {
 			renderer->meshChanged();
-			if (getType() == "modifier") editor->getModifiersManager()->modifierChanged(this);
+			if (getTypeID() == TYPE_MODIFIER) editor->getModifiersManager()->modifierChanged(this);
 			if (schematics_editor) schematics_editor->getSchematicsRenderingManager()->updateInstances();
 		} else {
 			renderer->positionChanged();
@@ -724,58 +848,105 @@ void Object::update(bool visually) {
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void Object::recursiveUpdateInformation(ObjectInitializer* initializer) {
+void Object::recursiveUpdateInformation(const QVector<ObjectInformation>& all_information) {
 	//Update information about the current object
-	TemporaryObject* temporary_object = initializer->getObject(this);
-	EVDS_OBJECT* evds_object = temporary_object->getEVDSObject();
+	if (editor_uid < all_information.count()) {
+		information = all_information[editor_uid];
+	} else {
+		information = ObjectInformation();
+	}
+
+	//Update information for all children
+	for (int i = 0; i < getChildrenCount(); i++) {
+		getChild(i)->recursiveUpdateInformation(all_information);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+static const char* FWE_ObjectInformation_VariableNames[ObjectInformation::VARIABLE_COUNT] = {
+	"mass",
+	"total_mass",
+	"fuel_mass",
+	"fuel_volume",
+	"vacuum.isp",
+	"vacuum.exhaust_velocity",
+	"vacuum.thrust",
+	"vacuum.mass_flow",
+	"vacuum.oxidizer_flow",
+	"vacuum.fuel_flow",
+	"atmospheric.isp",
+	"atmospheric.exhaust_velocity",
+	"atmospheric.thrust",
+	"atmospheric.mass_flow",
+	"atmospheric.oxidizer_flow",
+	"atmospheric.fuel_flow",
+	"combustion.of_ratio",
+	"combustion.temperature",
+	"combustion.pressure",
+};
+
+static const char* FWE_ObjectInformation_VectorNames[ObjectInformation::VECTOR_COUNT] = {
+	"cm",
+	"total_cm",
+	"total_ix",
+	"total_iy",
+	"total_iz",
+};
+
+ObjectInformation::ObjectInformation() {
+	for (int i = 0; i < VARIABLE_COUNT; i++) {
+		variables[i] = 0.0;
+		variableDefined[i] = false;
+	}
+	for (int i = 0; i < VECTOR_COUNT; i++) {
+		vectorDefined[i] = false;
+	}
+}
 
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Read all known variables in a single pass over objects variables
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInformation::read(EVDS_OBJECT* object) {
 	SIMC_LIST* list;
 	SIMC_LIST_ENTRY* entry;
 
-	//Scan all variables
-	EVDS_Object_GetVariables(evds_object,&list);
+	EVDS_Object_GetVariables(object,&list);
 	entry = SIMC_List_GetFirst(list);
 	while (entry) {
 		EVDS_VARIABLE* variable = (EVDS_VARIABLE*)SIMC_List_GetData(list,entry);
 
-		//Get name and type to fill out info_vectors/info_variables arrays
-		char name_str[65] = { 0 };
+		char name[65] = { 0 };
 		EVDS_VARIABLE_TYPE type;
-		EVDS_Variable_GetName(variable,name_str,64);
+		EVDS_Variable_GetName(variable,name,64);
 		EVDS_Variable_GetType(variable,&type);
 
-		QString name(name_str);
 		if (type == EVDS_VARIABLE_TYPE_FLOAT) { //Floating point var
-			info_variables[name] = temporary_object->getVariable(name);
+			for (int i = 0; i < VARIABLE_COUNT; i++) {
+				if (strcmp(name,FWE_ObjectInformation_VariableNames[i]) == 0) {
+					EVDS_REAL value;
+					EVDS_Variable_GetReal(variable,&value);
+					variables[i] = value;
+					variableDefined[i] = true;
+					break;
+				}
+			}
 		} else if (type == EVDS_VARIABLE_TYPE_VECTOR) { //Vector var
-			info_vectors[name] = temporary_object->getVector(name);
+			for (int i = 0; i < VECTOR_COUNT; i++) {
+				if (strcmp(name,FWE_ObjectInformation_VectorNames[i]) == 0) {
+					EVDS_VECTOR value;
+					EVDS_Variable_GetVector(variable,&value);
+					vectors[i] = QVector3D(value.x,value.y,value.z);
+					vectorDefined[i] = true;
+					break;
+				}
+			}
 		}
-
-		info_defined[name] = temporary_object->isVariableDefined(name);
 		entry = SIMC_List_GetNext(list,entry);
 	}
-
-	delete temporary_object;
-
-	//Update information for all children
-	for (int i = 0; i < getChildrenCount(); i++) {
-		getChild(i)->recursiveUpdateInformation(initializer);
-	}
-}
-
-double Object::getInformationVariable(const QString &name) {
-	if (!info_variables.contains(name)) return 0.0;
-	return info_variables[name];
-}
-
-QVector3D Object::getInformationVector(const QString &name) {
-	if (!info_vectors.contains(name)) return QVector3D();
-	return info_vectors[name];
-}
-
-bool Object::isInformationDefined(const QString &name) {
-	if (!info_defined.contains(name)) return false;
-	return info_defined[name];
 }
 
 
@@ -789,6 +960,7 @@ ObjectInitializer::ObjectInitializer(Object* in_object) {
 
 	//Initialize temporary object
 	object_copy = 0;
+	pending_copy = 0;
 
 	//Temporary hack to check in_object for validity
 	in_object->getType(); //Will crash when in_object is invalid
@@ -799,6 +971,9 @@ ObjectInitializer::ObjectInitializer(Object* in_object) {
 	doStopWork = false;
 	needObject = false; 
 	objectCompleted = true;
+	initializing = false;
+	publishDeferred = false;
+	fullUpdate = true;
 }
 
 
@@ -806,17 +981,35 @@ ObjectInitializer::ObjectInitializer(Object* in_object) {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 TemporaryObject* ObjectInitializer::getObject(Object* object) {
-	while (!objectCompleted) msleep(1); //Wait until object initialization is completed
-
 	readingLock.lock();
-	EVDS_OBJECT* found_object = 0;
-	EVDS_SYSTEM* system;
-	EVDS_Object_GetSystem(object_copy,&system);
-	if (EVDS_System_GetObjectByUID(system,object->getEditorUID(),object_copy,&found_object) != EVDS_OK) {
+	while (!objectCompleted) { //Wait until object initialization is completed
+		completedCondition.wait(&readingLock);
+	}
+
+	int uid = object->getEditorUID();
+	if ((uid >= objectIndex.count()) || (!objectIndex[uid])) {
 		qWarning("ObjectInitializer::getObject: could not find object");
-		return new TemporaryObject(object_copy,0);
+		return new TemporaryObject(object_copy,&readingLock);
+	}
+	return new TemporaryObject(objectIndex[uid],&readingLock);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get information about all objects in a single pass over the object index
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInitializer::getInformation(QVector<ObjectInformation>* information) {
+	readingLock.lock();
+	while (!objectCompleted) { //Wait until object initialization is completed
+		completedCondition.wait(&readingLock);
 	}
-	return new TemporaryObject(found_object,&readingLock);
+
+	information->clear();
+	information->resize(objectIndex.count());
+	for (int uid = 0; uid < objectIndex.count(); uid++) {
+		if (objectIndex[uid]) (*information)[uid].read(objectIndex[uid]);
+	}
+	readingLock.unlock();
 }
 
 
@@ -828,21 +1021,186 @@ TemporaryObject* ObjectInitializer::getObject(Object* object) {
 void ObjectInitializer::doUpdateObject() {
 	updateCallTimer.stop();
 	//qDebug("ObjectInitializer::doUpdateObject: fire!");
-	needObject = true;
-	if (this->isRunning()) {
-		readingLock.lock();
-			//Destroy old copy of initialized object
-			if (object_copy) EVDS_Object_Destroy(object_copy);
-			//Create new one
-			EVDS_Object_Copy(object->getEVDSObject(),0,&object_copy);
-			//Object not completed
-			objectCompleted = false;
-		readingLock.unlock();
+	if (!this->isRunning()) return;
+
+	//Make copies without holding the lock (source object is only modified by this thread).
+	// Entire object is still copied by this thread after structural changes
+	bool copyEntireObject = fullUpdate || (!object_copy) || (pending_copy && (!modifiedObjects.isEmpty()));
+	if ((!copyEntireObject) && (!pending_copy)) copyEntireObject = !copyModifiedSubtrees();
+	if (copyEntireObject) {
+		destroyPendingSubtrees();
+		if (pending_copy) EVDS_Object_Destroy(pending_copy);
+		EVDS_Object_Copy(object->getEVDSObject(),0,&pending_copy);
+		fullUpdate = false;
+		modifiedObjects.clear();
+	}
+
+	readingLock.lock();
+		//Do not wait for the initialization, changes will be published once it's done
+		if (initializing) {
+			publishDeferred = true;
+			readingLock.unlock();
+			return;
+		}
+
+		//Publish new copy, or replace modified subtrees in the existing one
+		if (pending_copy) {
+			if (object_copy) destroyedCopies.append(object_copy);
+			object_copy = pending_copy;
+			pending_copy = 0;
+			modifiedCopies.clear();
+			modifiedCopies.append(object_copy);
+		} else if (!publishModifiedSubtrees()) {
+			readingLock.unlock();
+			fullUpdate = true;
+			doUpdateObject();
+			return;
+		}
+
+		//Object not completed
+		objectCompleted = false;
+		//Wake up initializer thread
+		needObject = true;
+		workCondition.wakeOne();
+	readingLock.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Copy subtrees of the topmost modified objects (without holding the lock).
+///
+/// Returns false if the entire object must be copied instead (root was modified).
+////////////////////////////////////////////////////////////////////////////////
+bool ObjectInitializer::copyModifiedSubtrees() {
+	//Copies made earlier are still valid, if nothing was modified since then
+	if (modifiedObjects.isEmpty() && (!pendingSubtrees.isEmpty())) return true;
+
+	//Objects modified since last publish
+	QList<Object*> candidates = pendingObjects;
+	for (int i = 0; i < modifiedObjects.count(); i++) {
+		if (!candidates.contains(modifiedObjects[i])) candidates.append(modifiedObjects[i]);
+	}
+
+	//Find topmost modified objects
+	QList<Object*> objects;
+	for (int i = 0; i < candidates.count(); i++) {
+		Object* modified_object = candidates[i];
+		if (modified_object == object) return false;
+		if (!modified_object->getParent()) return false;
+
+		//Skip objects which are already included in a modified parents subtree
+		bool parentModified = false;
+		Object* parent = modified_object->getParent();
+		while (parent && (!parentModified)) {
+			parentModified = candidates.contains(parent);
+			parent = parent->getParent();
+		}
+		if (!parentModified) objects.append(modified_object);
+	}
+
+	//Copy subtrees (they are not part of the initialized copy until published)
+	destroyPendingSubtrees();
+	for (int i = 0; i < objects.count(); i++) {
+		EVDS_OBJECT* new_copy;
+		EVDS_Object_Copy(objects[i]->getEVDSObject(),0,&new_copy);
+		pendingSubtrees.append(new_copy);
+	}
+	pendingObjects = objects;
+	modifiedObjects.clear();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Destroy subtree copies which were not published
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInitializer::destroyPendingSubtrees() {
+	for (int i = 0; i < pendingSubtrees.count(); i++) {
+		EVDS_Object_Destroy(pendingSubtrees[i]);
+	}
+	pendingSubtrees.clear();
+	pendingObjects.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Replace subtrees of modified objects in the initialized copy with new copies.
+///
+/// Must be called with readingLock locked. Copies are only moved into place, old copies
+/// are destroyed by the worker thread. Returns false if the entire object must be copied
+/// instead (previous copy was not initialized yet, or old copy was not found).
+////////////////////////////////////////////////////////////////////////////////
+bool ObjectInitializer::publishModifiedSubtrees() {
+	if ((!object_copy) || needObject) return false;
+
+	//Find all old copies first, so nothing is modified if entire object must be copied
+	QList<EVDS_OBJECT*> old_copies;
+	QList<EVDS_OBJECT*> parent_copies;
+	for (int i = 0; i < pendingObjects.count(); i++) {
+		Object* modified_object = pendingObjects[i];
+
+		//Find old copy of the object and its parent
+		int uid = modified_object->getEditorUID();
+		int parent_uid = modified_object->getParent()->getEditorUID();
+		if ((uid >= objectIndex.count()) || (!objectIndex[uid])) return false;
+		if ((parent_uid >= objectIndex.count()) || (!objectIndex[parent_uid])) return false;
+
+		EVDS_OBJECT* old_copy = objectIndex[uid];
+		EVDS_OBJECT* parent_copy = objectIndex[parent_uid];
+
+		old_copies.append(old_copy);
+		parent_copies.append(parent_copy);
+	}
+
+	//Replace old copies with new ones
+	QHash<EVDS_OBJECT*,EVDS_OBJECT*> replaced_copies;
+	modifiedCopies.clear();
+	for (int i = 0; i < pendingSubtrees.count(); i++) {
+		SIMC_LIST* list;
+		SIMC_LIST_ENTRY* entry;
+		EVDS_OBJECT* head = 0;
+
+		//Find object which precedes old copy in the list
+		EVDS_Object_GetAllChildren(parent_copies[i],&list);
+		entry = SIMC_List_GetFirst(list);
+		while (entry) {
+			EVDS_OBJECT* child = (EVDS_OBJECT*)SIMC_List_GetData(list,entry);
+			if (child == old_copies[i]) break;
+			head = child;
+			entry = SIMC_List_GetNext(list,entry);
+		}
+		SIMC_List_Stop(list,entry);
+		if (replaced_copies.contains(head)) head = replaced_copies[head]; //Sibling was replaced too
+
+		//Move new copy into place of the old one
+		EVDS_OBJECT* new_copy = pendingSubtrees[i];
+		EVDS_Object_SetParent(new_copy,parent_copies[i]);
+		EVDS_Object_MoveInList(new_copy,head);
+		destroyedCopies.append(old_copies[i]);
+		replaced_copies[old_copies[i]] = new_copy;
+		modifiedCopies.append(new_copy);
 	}
+
+	//Copies are now owned by the initialized object
+	pendingSubtrees.clear();
+	pendingObjects.clear();
+	return true;
 }
 
-void ObjectInitializer::updateObject() {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Request update of the initialized copy.
+///
+/// If modified_object is specified, only its subtree will be copied and initialized
+/// again. Otherwise entire object is copied.
+////////////////////////////////////////////////////////////////////////////////
+void ObjectInitializer::updateObject(Object* modified_object) {
 	//qDebug("ObjectInitializer::updateObject: start timer");
+	if (modified_object) {
+		if (!modifiedObjects.contains(modified_object)) modifiedObjects.append(modified_object);
+	} else {
+		fullUpdate = true;
+	}
 	updateCallTimer.start(200);
 	//qDebug("ObjectInitializer::updateObject: requested update");
 	
@@ -852,7 +1210,7 @@ void ObjectInitializer::updateObject() {
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void FWE_ObjectInitializer_FixUIDs(EVDS_OBJECT* object) {
+void FWE_ObjectInitializer_FixUIDs(EVDS_OBJECT* object, QVector<EVDS_OBJECT*>* index) {
 	//Get userdata
 	void* userdata;
 	EVDS_Object_GetUserdata(object,&userdata);
@@ -863,8 +1221,11 @@ void FWE_ObjectInitializer_FixUIDs(EVDS_OBJECT* object) {
 		return;
 	}
 
-	//Set UID
-	EVDS_Object_SetUID(object,editor_object->getEditorUID());
+	//Set UID and add object to the index
+	int uid = editor_object->getEditorUID();
+	EVDS_Object_SetUID(object,uid);
+	if (uid >= index->count()) index->resize(uid+1);
+	(*index)[uid] = object;
 
 	//Get list of children
 	SIMC_LIST* list;
@@ -874,47 +1235,75 @@ void FWE_ObjectInitializer_FixUIDs(EVDS_OBJECT* object) {
 	//Do same for every child
 	entry = SIMC_List_GetFirst(list);
 	while (entry) {
-		FWE_ObjectInitializer_FixUIDs((EVDS_OBJECT*)SIMC_List_GetData(list,entry));
+		FWE_ObjectInitializer_FixUIDs((EVDS_OBJECT*)SIMC_List_GetData(list,entry),index);
 		entry = SIMC_List_GetNext(list,entry);
 	}
 }
 
 void ObjectInitializer::stopWork() {
-	doStopWork = true;
-	while (isRunning()) {
-		msleep(10);
-		//QApplication::processEvents();
-	}
+	readingLock.lock();
+		doStopWork = true;
+		workCondition.wakeAll();
+	readingLock.unlock();
+	wait();
 }
 
 void ObjectInitializer::run() {
-	msleep(2000); //Give enough time for the rest of application to initialize
-	while (!object_copy && (!doStopWork)) msleep(100); //Wait until there's an object to initialize
+	readingLock.lock();
 	while (!doStopWork) {
-		if (needObject) {
-			readingLock.lock();
-				//Start making the mesh
-				needObject = false;
-
-				//Transfer and initialize object
-				//qDebug("ObjectInitializer::run: initializing...");
-				EVDS_Object_TransferInitialization(object_copy); //Get rights to work with variables
-				FWE_ObjectInitializer_FixUIDs(object_copy); //Fix UID's for the objects
-				EVDS_Object_Initialize(object_copy,1);
-				EVDS_Object_Solve(object_copy,0.0);
-				//qDebug("ObjectInitializer::run: done!");
-
-				//Finish working
-				objectCompleted = true;
-			readingLock.unlock();
+		//Sleep until there's an object to initialize
+		while ((!needObject) && (!doStopWork)) {
+			workCondition.wait(&readingLock);
+		}
+		if (doStopWork) break;
+
+		//Take the work and release the lock, so interface thread is not blocked by initialization
+		needObject = false;
+		initializing = true;
+		EVDS_OBJECT* root_copy = object_copy;
+		QList<EVDS_OBJECT*> copies = modifiedCopies;
+		QList<EVDS_OBJECT*> destroyed_copies = destroyedCopies;
+		modifiedCopies.clear();
+		destroyedCopies.clear();
+		readingLock.unlock();
 
-			//If new mesh is needed, do not return generated one - return actually needed one instead
-			if (!needObject) {
-				emit signalObjectReady();
-			}
+		//Destroy copies which are no longer used
+		for (int i = 0; i < destroyed_copies.count(); i++) {
+			EVDS_Object_Destroy(destroyed_copies[i]);
+		}
+
+		//Transfer and initialize modified subtrees (or entire object). Readers do not
+		// access the index until initialization is completed
+		//qDebug("ObjectInitializer::run: initializing...");
+		if (copies.contains(root_copy)) objectIndex.clear();
+		for (int i = 0; i < copies.count(); i++) {
+			EVDS_Object_TransferInitialization(copies[i]); //Get rights to work with variables
+			FWE_ObjectInitializer_FixUIDs(copies[i],&objectIndex); //Fix UID's for the objects
+			EVDS_Object_Initialize(copies[i],1);
+		}
+
+		//Update total mass and other parameters of the parents
+		EVDS_Object_Solve(root_copy,0.0);
+		//qDebug("ObjectInitializer::run: done!");
+
+		//Finish working and wake up readers
+		readingLock.lock();
+		initializing = false;
+		objectCompleted = true;
+		completedCondition.wakeAll();
+		bool outdated = publishDeferred;
+		publishDeferred = false;
+		readingLock.unlock();
+
+		//If new mesh is needed, do not return generated one - publish changes and initialize again
+		if (outdated) {
+			QMetaObject::invokeMethod(this,"doUpdateObject",Qt::QueuedConnection);
+		} else {
+			emit signalObjectReady();
 		}
-		msleep(50);
+		readingLock.lock();
 	}
+	readingLock.unlock();
 
 	//Remove object
 	//qDebug("ObjectInitializer::run: stopped");
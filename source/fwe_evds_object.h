@@ -31,10 +31,13 @@
 
 #include <QObject>
 #include <QString>
+#include <QByteArray>
 #include <QVector3D>
 #include <QThread>
 #include <QMutex>
+#include <QWaitCondition>
 #include <QHash>
+#include <QVector>
 #include <QTimer>
 #include "evds.h"
 
@@ -49,6 +52,74 @@ namespace EVDS {
 	class ObjectRenderer;
 	class ObjectInitializer;
 	class CrossSectionEditor;
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Interned name of an EVDS variable.
+	///
+	/// Name is converted to UTF-8 once, when the handle is created. Hot code
+	/// paths should create handles once (as static variables) and reuse them. Handles
+	/// for the same name share the same string, so they are compared by pointer.
+	////////////////////////////////////////////////////////////////////////////////
+	class VariableName {
+	public:
+		explicit VariableName(const char* name);
+		explicit VariableName(const QString &name);
+
+		const char* data() const { return name; }
+		bool operator==(const VariableName &other) const { return name == other.name; }
+		bool operator!=(const VariableName &other) const { return name != other.name; }
+
+	private:
+		void intern(const QByteArray &utf8_name);
+
+		const char* name;
+	};
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Information about an initialized object (mass parameters, engine and tank figures)
+	////////////////////////////////////////////////////////////////////////////////
+	struct ObjectInformation {
+		enum Variable {
+			MASS,
+			TOTAL_MASS,
+			FUEL_MASS,
+			FUEL_VOLUME,
+			VACUUM_ISP,
+			VACUUM_EXHAUST_VELOCITY,
+			VACUUM_THRUST,
+			VACUUM_MASS_FLOW,
+			VACUUM_OXIDIZER_FLOW,
+			VACUUM_FUEL_FLOW,
+			ATMOSPHERIC_ISP,
+			ATMOSPHERIC_EXHAUST_VELOCITY,
+			ATMOSPHERIC_THRUST,
+			ATMOSPHERIC_MASS_FLOW,
+			ATMOSPHERIC_OXIDIZER_FLOW,
+			ATMOSPHERIC_FUEL_FLOW,
+			COMBUSTION_OF_RATIO,
+			COMBUSTION_TEMPERATURE,
+			COMBUSTION_PRESSURE,
+			VARIABLE_COUNT
+		};
+		enum Vector {
+			CM,
+			TOTAL_CM,
+			TOTAL_IX,
+			TOTAL_IY,
+			TOTAL_IZ,
+			VECTOR_COUNT
+		};
+
+		ObjectInformation();
+		//Read known variables from an initialized EVDS object
+		void read(EVDS_OBJECT* object);
+
+		double variables[VARIABLE_COUNT];
+		QVector3D vectors[VECTOR_COUNT];
+		bool variableDefined[VARIABLE_COUNT];
+		bool vectorDefined[VECTOR_COUNT];
+	};
+
 	class Object : public QObject {
 		Q_OBJECT
 
@@ -62,11 +133,31 @@ namespace EVDS {
 		QString getString(const QString &name);
 		QVector3D getVector(const QString &name);
 		bool isVariableDefined(const QString &name);
+
+		//Access to variables by interned name (no special "@" variables)
+		void setVariable(const VariableName &name, double value);
+		double getVariable(const VariableName &name);
+		QString getString(const VariableName &name);
+		QVector3D getVector(const VariableName &name);
+		bool isVariableDefined(const VariableName &name);
 		QString getName();
 		void setName(const QString &name);
 		QString getType();
 		void setType(const QString &type);
 
+		//Type of object, for fast comparisons
+		enum TypeID {
+			TYPE_OTHER,
+			TYPE_METADATA,
+			TYPE_MODIFIER,
+			TYPE_FUEL_TANK,
+			TYPE_ROCKET_ENGINE,
+			TYPE_SCHEMATICS,
+			TYPE_SCHEMATICS_SHEET,
+			TYPE_SCHEMATICS_ELEMENT
+		};
+		TypeID getTypeID() { if (!type_valid) updateType(); return type_id; }
+
 		int getChildrenCount() { return children.count(); }
 		Object* getChild(int index) { return children.at(index); }
 		int getChildIndex(Object* child) { return children.indexOf(child); }
@@ -98,10 +189,11 @@ namespace EVDS {
 		//void draw(bool objectSelected);
 
 		//Information
-		void recursiveUpdateInformation(ObjectInitializer* initializer);
-		double getInformationVariable(const QString &name);
-		QVector3D getInformationVector(const QString &name);
-		bool isInformationDefined(const QString &name);
+		void recursiveUpdateInformation(const QVector<ObjectInformation>& information);
+		double getInformationVariable(ObjectInformation::Variable variable) { return information.variables[variable]; }
+		QVector3D getInformationVector(ObjectInformation::Vector vector) { return information.vectors[vector]; }
+		bool isInformationDefined(ObjectInformation::Variable variable) { return information.variableDefined[variable]; }
+		bool isInformationDefined(ObjectInformation::Vector vector) { return information.vectorDefined[vector]; }
 
 	private slots:
 		void doubleChanged(const QString& name, double value);
@@ -110,10 +202,14 @@ namespace EVDS {
 		void meshReady();
 
 	private:
+		//Read type from the EVDS object
+		void updateType();
+		bool type_valid;
+		QString type;
+		TypeID type_id;
+
 		int editor_uid;
-		QHash<QString,QVector3D> info_vectors;
-		QHash<QString,double> info_variables;
-		QHash<QString,bool> info_defined;
+		ObjectInformation information;
 
 		EVDS_OBJECT* object;
 		EVDS::Editor* editor;
@@ -151,15 +247,17 @@ namespace EVDS {
 	public:
 		ObjectInitializer(Object* in_object);
 
-		//Re-initialize object
-		void updateObject();
-		//Abort thread work
+		//Re-initialize object (or only subtree of the given object, if it's not NULL)
+		void updateObject(Object* modified_object = 0);
+		//Abort thread work and wait until thread finishes
 		void stopWork();
 		//Locked when object is still inconsistent or when it's being read
 		QMutex readingLock;
 
-		//Get temporary object for a real object (by unique identifier)
+		//Get temporary object for a real object (by unique identifier). Blocks until object is initialized
 		TemporaryObject* getObject(Object* object);
+		//Get information for all objects (indexed by editor UID). Blocks until object is initialized
+		void getInformation(QVector<ObjectInformation>* information);
 
 	public slots:
 		void doUpdateObject();
@@ -172,12 +270,32 @@ namespace EVDS {
 	
 	private:
 		QTimer updateCallTimer;
+		QWaitCondition workCondition; //Signalled when new object must be initialized or thread must stop
+		QWaitCondition completedCondition; //Signalled when object initialization is completed
 		bool doStopWork; //Stop threads work
 		bool needObject; //Is new object required
 		bool objectCompleted; //Is object ready to be read
+		bool initializing; //Is thread initializing the copy (copy must not be modified)
+		bool publishDeferred; //Changes must be published once initialization is done
+
+		//Copy subtrees of modified objects (outside of the lock). Returns false if entire object must be copied
+		bool copyModifiedSubtrees();
+		//Destroy subtree copies which were not published
+		void destroyPendingSubtrees();
+		//Move copied subtrees into existing copy (under the lock). Returns false if entire object must be copied
+		bool publishModifiedSubtrees();
 
 		Object* object; //Object which is initialized
-		EVDS_OBJECT* object_copy;
+		EVDS_OBJECT* object_copy; //Copy which is initialized or read (protected by readingLock)
+		EVDS_OBJECT* pending_copy; //Full copy which was not yet published (only used by interface thread)
+
+		bool fullUpdate; //Entire object must be copied and initialized
+		QList<Object*> modifiedObjects; //Objects which were modified since last copy
+		QList<EVDS_OBJECT*> modifiedCopies; //Copies of modified subtrees which must be initialized
+		QList<Object*> pendingObjects; //Topmost modified objects whose subtrees were copied, but not published
+		QList<EVDS_OBJECT*> pendingSubtrees; //Copies of their subtrees (only used by interface thread)
+		QList<EVDS_OBJECT*> destroyedCopies; //Copies which are no longer used and must be destroyed
+		QVector<EVDS_OBJECT*> objectIndex; //Objects of the initialized copy indexed by editor UID
 	};
 }
 
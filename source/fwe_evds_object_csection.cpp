@@ -136,7 +136,7 @@ void CrossSectionEditor::sectionSelected(int index) {
 		//Update geometry, unless this is the first cross-section to be created
 		if (index != 0) {
 			object->update(true);
-			object->getEVDSEditor()->setModified();
+			object->getEVDSEditor()->setModified(object);
 		}
 	}
 	sections->setCurrentIndex(index);
@@ -172,7 +172,7 @@ void CrossSectionEditor::sectionDeleted(int index) {
 
 	//Update geometry
 	object->update(true);
-	object->getEVDSEditor()->setModified();
+	object->getEVDSEditor()->setModified(object);
 }
 
 
@@ -209,7 +209,7 @@ void CrossSectionEditor::sectionMoved(int from, int to) {
 
 	//Update geometry
 	object->update(true);
-	object->getEVDSEditor()->setModified();
+	object->getEVDSEditor()->setModified(object);
 }
 
 
@@ -327,7 +327,7 @@ void CrossSection::setVariable(const QString &name, double value) {
 		}
 	}
 	editor->getObject()->update(true);
-	editor->getObject()->getEVDSEditor()->setModified();
+	editor->getObject()->getEVDSEditor()->setModified(editor->getObject());
 }
 
 
@@ -358,7 +358,7 @@ void CrossSection::setVariable(const QString &name, const QString &value) {
 		//FIXME
 	}
 	editor->getObject()->update(true);
-	editor->getObject()->getEVDSEditor()->setModified();
+	editor->getObject()->getEVDSEditor()->setModified(editor->getObject());
 }
 
 
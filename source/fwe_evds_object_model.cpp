@@ -34,6 +34,13 @@
 using namespace EVDS;
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Names of variables used for displaying objects
+////////////////////////////////////////////////////////////////////////////////
+static const VariableName var_disable("disable");
+static const VariableName var_pattern("pattern");
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,23 +78,22 @@ QVariant ObjectTreeModel::data(const QModelIndex &index, int role) const {
 	//Return icon
 	Object* object = (Object*)(index.internalPointer());
 	if ((role == Qt::DecorationRole) && (index.column() == 0)) {
-		QString type = object->getType();
-
-		if (type == "fuel_tank") {
+		if (object->getTypeID() == Object::TYPE_FUEL_TANK) {
 			if (object->isOxidizerTank()) {
 				return QIcon(":/icon/evds_type/fuel_tank_oxy.png");
 			} else {
 				return QIcon(":/icon/evds_type/fuel_tank_fuel.png");
 			}
-		} else if (type == "modifier") {
-			if (object->getString("pattern") == "copy") {
+		} else if (object->getTypeID() == Object::TYPE_MODIFIER) {
+			if (object->getString(var_pattern) == "copy") {
 				return QIcon(":/icon/evds_type/modifier_copy.png");
-			} else if (object->getString("pattern") == "circular") {
+			} else if (object->getString(var_pattern) == "circular") {
 				return QIcon(":/icon/evds_type/modifier_circular.png");
 			} else {
 				return QIcon(":/icon/evds_type/modifier_linear.png");
 			}
 		} else {
+			QString type = object->getType();
 			if (QFile::exists(":/icon/evds_type/" + type + ".png")) {
 				return QIcon(":/icon/evds_type/" + type + ".png");
 			} else {
@@ -97,7 +103,7 @@ QVariant ObjectTreeModel::data(const QModelIndex &index, int role) const {
 	}
 
 	//Show item as disabled
-	if (object->getVariable("disable") > 0.5) {
+	if (object->getVariable(var_disable) > 0.5) {
 		if (role == Qt::ForegroundRole) {
 			return QColor(96,96,96);
 		}
@@ -31,10 +31,18 @@
 #include "fwe_evds_object.h"
 #include "fwe_evds_object_renderer.h"
 #include "fwe_evds_glscene.h"
+#include "fwe_evds_instanced_renderer.h"
+#include "fwe_evds_mesh_scheduler.h"
 
 using namespace EVDS;
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Names of variables used by the renderer
+////////////////////////////////////////////////////////////////////////////////
+static const VariableName var_disable("disable");
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
@@ -45,18 +53,16 @@ ObjectRenderer::ObjectRenderer(Object* in_object) {
 	glcMesh = new GLC_Mesh();
 	glcMeshRep = new GLC_3DRep(glcMesh);
 	glcInstance = new GLC_3DViewInstance(*glcMeshRep);
+	positionDirty = false;
 
 	//Read LOD count and make sure it's sane
 	int lod_count = fw_editor_settings->value("rendering.lod_count").toInt();
 	if (lod_count < 1) lod_count = 1;
 	if (lod_count > 20) lod_count = 20;
 
-	//Create mesh generators
+	//Create mesh generators (LOD jobs are executed by the shared mesh scheduler)
 	lodMeshGenerator = new ObjectLODGenerator(object,lod_count);
 	connect(lodMeshGenerator, SIGNAL(signalLODsReady()), this, SLOT(lodMeshesGenerated()), Qt::QueuedConnection);
-	if (fw_editor_settings->value("rendering.no_lods") == false) {
-		lodMeshGenerator->start();
-	}
 }
 
 
@@ -67,11 +73,16 @@ ObjectRenderer::~ObjectRenderer() {
 	//Remove instances from modifiers
 	//removeFromModifiers(object);
 
+	//Make sure renderer is not updated anymore
+	object->getEVDSEditor()->rendererRemoved(this);
+
 	//Remove instances from glview
 	GLScene* glview = object->getEVDSEditor()->getGLScene();
 	if (glview->getCollection()->contains(glcInstance->id())) {
 		glview->getCollection()->remove(glcInstance->id());
+		glview->invalidateGeometry();
 	}
+	glview->getInstancedRenderer()->invalidateMesh(glcMesh);
 
 	delete glcInstance;
 	lodMeshGenerator->stopWork();
@@ -79,9 +90,35 @@ ObjectRenderer::~ObjectRenderer() {
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief
+/// @brief Mark transformation as dirty. It will be recalculated before the next frame
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectRenderer::positionChanged() {
+	if (positionDirty) return;
+	positionDirty = true;
+	object->getEVDSEditor()->transformationChanged(this);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectRenderer::updateTransformation() {
+	if (!positionDirty) return; //Already updated together with one of the parents
+
+	//Parent which was moved will update this object as well
+	Object* parent = object->getParent();
+	while (parent) {
+		if (parent->getRenderer() && parent->getRenderer()->isPositionDirty()) return;
+		parent = parent->getParent();
+	}
+	calculateTransformation();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectRenderer::calculateTransformation() {
 	GLScene* glview = object->getEVDSEditor()->getGLScene();
 
 	//Offset GLC instance relative to objects parent
@@ -102,7 +139,7 @@ void ObjectRenderer::positionChanged() {
 		glcInstance->translate(vector.position.x,vector.position.y,vector.position.z);
 
 		//Update visibility of this object
-		if (object->getVariable("disable") > 0.5) {
+		if (object->getVariable(var_disable) > 0.5) {
 			glcInstance->setVisibility(false);
 		} else {
 			glcInstance->setVisibility(true);
@@ -119,16 +156,14 @@ void ObjectRenderer::positionChanged() {
 			}
 		}
 		
-		//Add/replace in GL widget to update position
-		if (glview->getCollection()->contains(glcInstance->id())) {
-			glview->getCollection()->remove(glcInstance->id());
-		}
-		glview->getCollection()->add(*(glcInstance));
+		//Update instance stored in GL widget
+		glview->updateInstance(*glcInstance);
 	}
+	positionDirty = false;
 
 	//Update position of all children
 	for (int i = 0; i < object->getChildrenCount(); i++) {
-		object->getChild(i)->getRenderer()->positionChanged();
+		object->getChild(i)->getRenderer()->calculateTransformation();
 	}
 }
 
@@ -137,7 +172,7 @@ void ObjectRenderer::positionChanged() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectRenderer::meshChanged() {
-	if (object->getType() != "modifier") {
+	if (object->getTypeID() != Object::TYPE_MODIFIER) {
 		EVDS_MESH* mesh;
 
 		//Create temporary object
@@ -179,6 +214,10 @@ void ObjectRenderer::meshChanged() {
 		glcMesh->finish();
 		glcMesh->clearBoundingBox(); //Clear bounding box to update it
 	}
+
+	//Copies drawn by instancing must use the new mesh
+	object->getEVDSEditor()->getGLScene()->getInstancedRenderer()->invalidateMesh(glcMesh);
+	object->getEVDSEditor()->getGLScene()->invalidateGeometry();
 }
 
 
@@ -192,8 +231,13 @@ void ObjectRenderer::lodMeshesGenerated() {
 		glcMesh->clear();
 		lodMeshGenerator->getResult()->setGLCMesh(glcMesh,object);
 		glcMesh->finish();
+		object->getEVDSEditor()->getGLScene()->getInstancedRenderer()->invalidateMesh(glcMesh);
+		object->getEVDSEditor()->getGLScene()->invalidateGeometry();
 
 		glcInstance->setMatrix(glcInstance->matrix()); //This causes bounding box to be updated
+		if (!positionDirty) { //Stored instance is updated with the next transformation otherwise
+			object->getEVDSEditor()->getGLScene()->updateInstance(*glcInstance);
+		}
 		object->getEVDSEditor()->updateObject(NULL); //Force into repaint
 	lodMeshGenerator->readingLock.unlock();
 
@@ -267,7 +311,7 @@ void ObjectLODGeneratorResult::setGLCMesh(GLC_Mesh* glcMesh, Object* object) {
 			GLC_Material* glcMaterial = new GLC_Material();
 			
 			//Special color logic
-			if (object->getType() == "fuel_tank") {
+			if (object->getTypeID() == Object::TYPE_FUEL_TANK) {
 				if (object->isOxidizerTank()) {
 					glcMaterial->setDiffuseColor(QColor(0,0,255));
 				} else {
@@ -292,31 +336,51 @@ void ObjectLODGeneratorResult::clear() {
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Job which generates LODs for a single copy of an object
+////////////////////////////////////////////////////////////////////////////////
+class ObjectLODGeneratorJob : public MeshJob {
+public:
+	ObjectLODGeneratorJob(ObjectLODGenerator* in_generator, EVDS_OBJECT* in_object, int in_generation) {
+		generator = in_generator;
+		object_copy = in_object;
+		generation = in_generation;
+	}
+	void run() {
+		generator->generateLODs(object_copy,generation);
+	}
+
+private:
+	ObjectLODGenerator* generator;
+	EVDS_OBJECT* object_copy;
+	int generation;
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 float ObjectLODGenerator::getLODResolution(int lod) {
-	float quality = fw_editor_settings->value("rendering.lod_quality").toFloat();
-	return quality * (1 + lod);
+	return lodQuality * (1 + lod);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-ObjectLODGenerator::ObjectLODGenerator(Object* in_object, int in_lods) {
+ObjectLODGenerator::ObjectLODGenerator(Object* in_object, int in_lods) : currentGeneration(0) {
 	object = in_object;
 	numLods = in_lods;
 	editor = object->getEVDSEditor();
 
-	//Initialize temporary object
-	object_copy = 0;
+	//Settings are read here, because jobs run outside of the GUI thread
+	lodQuality = fw_editor_settings->value("rendering.lod_quality").toFloat();
+	minResolution = fw_editor_settings->value("rendering.min_resolution").toFloat();
+	lodsEnabled = fw_editor_settings->value("rendering.no_lods") == false;
 
-	//Delete thread when work is finished
-	connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
 	connect(&updateCallTimer, SIGNAL(timeout()), this, SLOT(doUpdateMesh()));
 	doStopWork = false;
-	needMesh = false; 
+	activeJobs = 0;
 }
 
 
@@ -329,16 +393,29 @@ ObjectLODGeneratorResult* ObjectLODGenerator::getResult() {
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief Get a temporary copy of the rendered object
+/// @brief Submit a temporary copy of the rendered object to the mesh scheduler
+///
+/// Every submitted job gets a new generation number. Jobs of older generations
+/// are aborted as soon as they notice a newer job was submitted.
 ////////////////////////////////////////////////////////////////////////////////
 void ObjectLODGenerator::doUpdateMesh() {
 	updateCallTimer.stop();
-	readingLock.lock();
-		needMesh = true;
-		if (this->isRunning()) {
-			EVDS_Object_CopySingle(object->getEVDSObject(),0,&object_copy);
+	if (!lodsEnabled) return;
+
+	jobLock.lock();
+		if (doStopWork) {
+			jobLock.unlock();
+			return;
 		}
-	readingLock.unlock();
+		activeJobs++;
+	jobLock.unlock();
+
+	EVDS_OBJECT* object_copy;
+	EVDS_Object_CopySingle(object->getEVDSObject(),0,&object_copy);
+	int generation = currentGeneration.fetchAndAddOrdered(1) + 1;
+
+	editor->addActiveThread();
+	MeshJobScheduler::instance()->submit(new ObjectLODGeneratorJob(this,object_copy,generation));
 }
 
 void ObjectLODGenerator::updateMesh() {
@@ -347,70 +424,85 @@ void ObjectLODGenerator::updateMesh() {
 }
 
 void ObjectLODGenerator::stopWork() {
-	doStopWork = true;
+	updateCallTimer.stop();
+	currentGeneration.fetchAndAddOrdered(1); //Outdate all queued jobs
+
+	jobLock.lock();
+		doStopWork = true;
+		bool canDelete = (activeJobs == 0);
+	jobLock.unlock();
+
+	//Otherwise the last job deletes the generator
+	if (canDelete) deleteLater();
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void ObjectLODGenerator::run() {
-	editor->addActiveThread();
-	//msleep(1000 + (qrand() % 5000)); //Give enough time for the rest of application to initialize
-	while (!doStopWork) {
-		readingLock.lock();
-		if (needMesh) {
-			//Start making the mesh
-			needMesh = false;
-			ObjectLODGenerator::threadsSemaphore.acquire();
-
-			//Transfer and initialize work object
-			EVDS_OBJECT* work_object = object_copy; //Fetch the pointer
-			EVDS_Object_TransferInitialization(work_object); //Get rights to work with variables
-			EVDS_Object_Initialize(work_object,1);
-			object_copy = 0;
-
-			result.clear();
-			for (int lod = 0; lod < numLods; lod++) {
-				//Check if job must be aborted
-				if (needMesh || doStopWork) {
-					qDebug("ObjectLODGenerator: aborted job early");
-					break;
-				}
+bool ObjectLODGenerator::isJobOutdated(int generation) {
+	return generation != (int)currentGeneration;
+}
 
-				//Create new one
-				EVDS_MESH* mesh;
-				EVDS_MESH_GENERATEEX info = { 0 };
-				info.resolution = getLODResolution(numLods-lod-1);
-				info.min_resolution = fw_editor_settings->value("rendering.min_resolution").toFloat();
-				info.flags = EVDS_MESH_USE_DIVISIONS;
+void ObjectLODGenerator::finishJob() {
+	editor->removeActiveThread();
 
-				EVDS_Mesh_GenerateEx(work_object,&mesh,&info);
-				result.appendMesh(mesh,lod);
-				EVDS_Mesh_Destroy(mesh);
-				//printf("Done mesh %p %p for level %d\n",object,mesh,lod);
-			}
+	jobLock.lock();
+		activeJobs--;
+		bool canDelete = doStopWork && (activeJobs == 0);
+	jobLock.unlock();
 
-			//Make sure not too many threads run expensive tasks at once
-			ObjectLODGenerator::threadsSemaphore.release();
+	if (canDelete) deleteLater();
+}
 
-			//Release the object that was worked on
-			if (work_object) {
-				EVDS_Object_Destroy(work_object);
-			}
 
-			//If new mesh is needed, do not return generated one - return actually needed one instead
-			if (!needMesh) {
-				emit signalLODsReady();
-			}
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ObjectLODGenerator::generateLODs(EVDS_OBJECT* work_object, int generation) {
+	//Skip jobs which were already replaced by newer ones
+	if (isJobOutdated(generation)) {
+		EVDS_Object_Destroy(work_object);
+		finishJob();
+		return;
+	}
+
+	//Transfer and initialize work object
+	EVDS_Object_TransferInitialization(work_object); //Get rights to work with variables
+	EVDS_Object_Initialize(work_object,1);
+
+	ObjectLODGeneratorResult job_result;
+	bool aborted = false;
+	for (int lod = 0; lod < numLods; lod++) {
+		//Check if job must be aborted
+		if (isJobOutdated(generation)) {
+			qDebug("ObjectLODGenerator: aborted job early");
+			aborted = true;
+			break;
 		}
-		readingLock.unlock();
-		msleep(50);
+
+		//Create new one
+		EVDS_MESH* mesh;
+		EVDS_MESH_GENERATEEX info = { 0 };
+		info.resolution = getLODResolution(numLods-lod-1);
+		info.min_resolution = minResolution;
+		info.flags = EVDS_MESH_USE_DIVISIONS;
+
+		EVDS_Mesh_GenerateEx(work_object,&mesh,&info);
+		job_result.appendMesh(mesh,lod);
+		EVDS_Mesh_Destroy(mesh);
+		//printf("Done mesh %p %p for level %d\n",object,mesh,lod);
 	}
 
-	//Finish thread work and destroy HQ mesh
-	//qDebug("ObjectLODGenerator::run: stopped");
-	editor->removeActiveThread();
-}
+	//Release the object that was worked on
+	EVDS_Object_Destroy(work_object);
 
-QSemaphore ObjectLODGenerator::threadsSemaphore(QThread::idealThreadCount());
\ No newline at end of file
+	//If new mesh is needed, do not return generated one - return actually needed one instead
+	if ((!aborted) && (!isJobOutdated(generation))) {
+		readingLock.lock();
+			result = job_result;
+		readingLock.unlock();
+		emit signalLODsReady();
+	}
+	finishJob();
+}
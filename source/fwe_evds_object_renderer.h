@@ -29,9 +29,10 @@
 #ifndef FWE_EVDS_OBJECT_RENDERER_H
 #define FWE_EVDS_OBJECT_RENDERER_H
 
-#include <QThread>
+#include <QObject>
 #include <QMutex>
-#include <QSemaphore>
+#include <QTimer>
+#include <QAtomicInt>
 
 #include <GLC_Mesh>
 #include <GLC_3DViewInstance>
@@ -53,6 +54,13 @@ namespace EVDS {
 		GLC_3DViewInstance* getInstance() { return glcInstance; }
 		GLC_3DRep* getRepresentation() { return glcMeshRep; }
 
+		//Recalculate transformation of this object and its children, unless a moved parent will do it
+		void updateTransformation();
+		//Calculate transformation of this object and all of its children
+		void calculateTransformation();
+		//Must transformation be recalculated before next frame
+		bool isPositionDirty() { return positionDirty; }
+
 	public slots:
 		//Notifies that objects mesh has changed and must be re-generated
 		void meshChanged();
@@ -67,6 +75,9 @@ namespace EVDS {
 		GLC_3DRep* glcMeshRep;
 		GLC_3DViewInstance* glcInstance;
 
+		//Transformation will be recalculated in the next batched update
+		bool positionDirty;
+
 		//Object to render
 		Object* object;
 		ObjectLODGenerator* lodMeshGenerator;
@@ -86,7 +97,7 @@ namespace EVDS {
 	};
 
 
-	class ObjectLODGenerator : public QThread {
+	class ObjectLODGenerator : public QObject {
 		Q_OBJECT
 
 	public:
@@ -96,16 +107,16 @@ namespace EVDS {
 		ObjectLODGeneratorResult* getResult();
 		//Update mesh for the given object
 		void updateMesh();
-		//Abort thread work
+		//Abort work and delete generator once no queued jobs refer to it
 		void stopWork();
 		//Locked when mesh is being generated
 		QMutex readingLock;
 
-		//Get number of lods
+		//Get number of LODs
 		int getNumLODs() { return numLods; }
 
-	public:
-		static QSemaphore threadsSemaphore;
+		//Generate LODs for a copy of the object (called from mesh scheduler worker)
+		void generateLODs(EVDS_OBJECT* work_object, int generation);
 
 	public slots:
 		void doUpdateMesh();
@@ -113,21 +124,24 @@ namespace EVDS {
 	signals:
 		void signalLODsReady();
 
-	protected:
-		void run();
-	
 	private:
 		float getLODResolution(int lod); //Get resolution for LOD level
+		bool isJobOutdated(int generation); //Was job replaced by a newer one
+		void finishJob(); //Called when job is no longer running
 
 		QTimer updateCallTimer;
-		bool doStopWork; //Stop threads work
-		bool needMesh; //Is new mesh required
+		QMutex jobLock; //Protects activeJobs and doStopWork
+		int activeJobs; //Jobs queued or running for this generator
+		bool doStopWork; //Stop generator work
+		bool lodsEnabled; //Should LODs be generated at all
+		QAtomicInt currentGeneration; //Index of the most recent job
 
 		Object* object; //Object for which mesh is generated
 		Editor* editor; //Objects editor
-		EVDS_OBJECT* object_copy; //Copy of the object for this thread
 
 		int numLods; //Total number of LODs
+		float lodQuality; //Tessellation quality
+		float minResolution; //Minimum tessellation resolution
 		ObjectLODGeneratorResult result; //Generated meshes
 	};
 }
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#include "fwe_evds_render_target_pool.h"
+
+using namespace EVDS;
+
+//Sizes of targets are rounded up to this many pixels
+#define FWE_RENDER_TARGET_GRANULARITY	64
+//Target is kept until it is this many pixels larger than required
+#define FWE_RENDER_TARGET_HYSTERESIS	128
+//Maximum number of released targets kept in the pool
+#define FWE_RENDER_TARGET_MAX_RELEASED	6
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief List of targets not used by any scene
+////////////////////////////////////////////////////////////////////////////////
+QList<QGLFramebufferObject*>& RenderTargetPool::releasedTargets() {
+	static QList<QGLFramebufferObject*> targets;
+	return targets;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+QSize RenderTargetPool::roundSize(const QSize& size) {
+	int width = qMax(1,size.width());
+	int height = qMax(1,size.height());
+	width = ((width + FWE_RENDER_TARGET_GRANULARITY - 1) / FWE_RENDER_TARGET_GRANULARITY) * FWE_RENDER_TARGET_GRANULARITY;
+	height = ((height + FWE_RENDER_TARGET_GRANULARITY - 1) / FWE_RENDER_TARGET_GRANULARITY) * FWE_RENDER_TARGET_GRANULARITY;
+	return QSize(width,height);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Check if target is large enough, but not too large for the given size
+////////////////////////////////////////////////////////////////////////////////
+bool RenderTargetPool::fits(QGLFramebufferObject* target, const QSize& size) {
+	QSize rounded = roundSize(size);
+	return (target->width() >= size.width()) &&
+		   (target->height() >= size.height()) &&
+		   (target->width() <= rounded.width() + FWE_RENDER_TARGET_HYSTERESIS) &&
+		   (target->height() <= rounded.height() + FWE_RENDER_TARGET_HYSTERESIS);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Get target of the given size.
+///
+/// Only released targets of exactly the rounded size are reused, so all targets
+/// acquired for the same size have same dimensions.
+////////////////////////////////////////////////////////////////////////////////
+QGLFramebufferObject* RenderTargetPool::acquire(const QSize& size, QGLFramebufferObject::Attachment attachment) {
+	QSize rounded = roundSize(size);
+	QList<QGLFramebufferObject*>& targets = releasedTargets();
+	for (int i = targets.count()-1; i >= 0; i--) {
+		if ((targets[i]->size() == rounded) && (targets[i]->attachment() == attachment)) {
+			return targets.takeAt(i);
+		}
+	}
+	return new QGLFramebufferObject(rounded,attachment,GL_TEXTURE_2D,GL_RGBA8);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void RenderTargetPool::release(QGLFramebufferObject* target) {
+	if (!target) return;
+
+	QList<QGLFramebufferObject*>& targets = releasedTargets();
+	targets.append(target);
+	while (targets.count() > FWE_RENDER_TARGET_MAX_RELEASED) {
+		delete targets.takeFirst();
+	}
+}
@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EVDS_RENDER_TARGET_POOL_H
+#define FWE_EVDS_RENDER_TARGET_POOL_H
+
+#include <QList>
+#include <QSize>
+#include <QGLFramebufferObject>
+
+namespace EVDS {
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Offscreen render targets shared by all scenes.
+	///
+	/// Targets are allocated with sizes rounded up to 64 pixels, and a scene keeps its
+	/// targets while they are large enough (and not too large) for the view. This way
+	/// small changes of the view size do not cause reallocation.
+	///
+	/// All views share OpenGL context with GLView::getShareWidget(), so targets released
+	/// by a hidden scene are taken by the next scene which needs them.
+	////////////////////////////////////////////////////////////////////////////////
+	class RenderTargetPool {
+	public:
+		//Get target of the given size (rounded up). Released target is reused if possible
+		static QGLFramebufferObject* acquire(const QSize& size, QGLFramebufferObject::Attachment attachment);
+		//Return target into the pool (oldest released targets are destroyed if there are too many)
+		static void release(QGLFramebufferObject* target);
+		//Can target be kept for the given size
+		static bool fits(QGLFramebufferObject* target, const QSize& size);
+
+	private:
+		static QSize roundSize(const QSize& size);
+		static QList<QGLFramebufferObject*>& releasedTargets();
+	};
+}
+
+#endif
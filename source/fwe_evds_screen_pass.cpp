@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#include <QGLContext>
+#include <QGLFunctions>
+
+#include "fwe_evds_screen_pass.h"
+
+using namespace EVDS;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+ScreenPass::ScreenPass() {
+	shader = 0;
+	target = 0;
+	textures[0] = 0;
+	textures[1] = 0;
+	textureScale = QSizeF(1.0,1.0);
+	blend = true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void ScreenPass::setUniform(const char* name, GLint value) {
+	Uniform uniform;
+	uniform.name = name;
+	uniform.components = 0;
+	uniform.integer = value;
+	uniforms.append(uniform);
+}
+void ScreenPass::setUniform(const char* name, GLfloat x) {
+	Uniform uniform;
+	uniform.name = name;
+	uniform.components = 1;
+	uniform.value[0] = x;
+	uniforms.append(uniform);
+}
+void ScreenPass::setUniform(const char* name, GLfloat x, GLfloat y) {
+	Uniform uniform;
+	uniform.name = name;
+	uniform.components = 2;
+	uniform.value[0] = x;
+	uniform.value[1] = y;
+	uniforms.append(uniform);
+}
+void ScreenPass::setUniform(const char* name, GLfloat x, GLfloat y, GLfloat z) {
+	Uniform uniform;
+	uniform.name = name;
+	uniform.components = 3;
+	uniform.value[0] = x;
+	uniform.value[1] = y;
+	uniform.value[2] = z;
+	uniforms.append(uniform);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Vertex buffer with a single triangle covering the entire screen.
+///
+/// Shared by all views (their contexts share objects).
+////////////////////////////////////////////////////////////////////////////////
+QGLBuffer* ScreenPassChain::getTriangleBuffer() {
+	static QGLBuffer* buffer = 0;
+	if (!buffer) {
+		static const GLfloat vertices[] = {
+			-1.0f, -1.0f,
+			 3.0f, -1.0f,
+			-1.0f,  3.0f,
+		};
+
+		buffer = new QGLBuffer(QGLBuffer::VertexBuffer);
+		buffer->setUsagePattern(QGLBuffer::StaticDraw);
+		if (!buffer->create()) {
+			qWarning("ScreenPassChain: could not create vertex buffer");
+			delete buffer;
+			buffer = 0;
+			return 0;
+		}
+		buffer->bind();
+		buffer->allocate(vertices,sizeof(vertices));
+		buffer->release();
+	}
+	return buffer;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+ScreenPass& ScreenPassChain::add(QGLShaderProgram* shader, QGLFramebufferObject* target) {
+	ScreenPass pass;
+	pass.shader = shader;
+	pass.target = target;
+	passes.append(pass);
+	return passes.last();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Draw all passes. Previous render state is restored afterwards
+////////////////////////////////////////////////////////////////////////////////
+void ScreenPassChain::run() {
+	QGLBuffer* triangle = getTriangleBuffer();
+	if ((!triangle) || passes.isEmpty()) return;
+	QGLFunctions functions(QGLContext::currentContext());
+
+	//Set up state for the entire chain
+	GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	triangle->bind();
+
+	QGLFramebufferObject* target = 0;
+	for (int i = 0; i < passes.count(); i++) {
+		const ScreenPass& pass = passes[i];
+		if (!pass.shader) continue;
+
+		//Switch framebuffer
+		if (pass.target != target) {
+			if (target) target->release();
+			target = pass.target;
+			if (target) target->bind();
+		}
+
+		//Bind textures
+		if (pass.textures[1]) {
+			functions.glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, pass.textures[1]);
+			functions.glActiveTexture(GL_TEXTURE0);
+		}
+		if (pass.textures[0]) {
+			glBindTexture(GL_TEXTURE_2D, pass.textures[0]);
+		}
+		if (pass.blend) {
+			glEnable(GL_BLEND);
+		} else {
+			glDisable(GL_BLEND);
+		}
+
+		//Set up shader
+		pass.shader->bind();
+		pass.shader->setUniformValue("v_texScale",(GLfloat)pass.textureScale.width(),(GLfloat)pass.textureScale.height());
+		for (int j = 0; j < pass.uniforms.count(); j++) {
+			const ScreenPass::Uniform& uniform = pass.uniforms[j];
+			switch (uniform.components) {
+				case 0: pass.shader->setUniformValue(uniform.name.constData(),uniform.integer); break;
+				case 1: pass.shader->setUniformValue(uniform.name.constData(),uniform.value[0]); break;
+				case 2: pass.shader->setUniformValue(uniform.name.constData(),uniform.value[0],uniform.value[1]); break;
+				case 3: pass.shader->setUniformValue(uniform.name.constData(),uniform.value[0],uniform.value[1],uniform.value[2]); break;
+			}
+		}
+
+		//Draw the triangle
+		int position_attribute = pass.shader->attributeLocation("a_position");
+		pass.shader->enableAttributeArray(position_attribute);
+		pass.shader->setAttributeBuffer(position_attribute,GL_FLOAT,0,2);
+		glDrawArrays(GL_TRIANGLES,0,3);
+		pass.shader->disableAttributeArray(position_attribute);
+		pass.shader->release();
+	}
+	if (target) target->release();
+
+	//Restore state
+	triangle->release();
+	if (depth_test) glEnable(GL_DEPTH_TEST);
+	if (cull_face) glEnable(GL_CULL_FACE);
+	if (blend) {
+		glEnable(GL_BLEND);
+	} else {
+		glDisable(GL_BLEND);
+	}
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EVDS_SCREEN_PASS_H
+#define FWE_EVDS_SCREEN_PASS_H
+
+#include <QList>
+#include <QSizeF>
+#include <QByteArray>
+#include <QGLBuffer>
+#include <QGLShaderProgram>
+#include <QGLFramebufferObject>
+
+namespace EVDS {
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Single full-screen pass of a post-processing chain.
+	///
+	/// Vertex shader of the pass receives screen position in "a_position" and must
+	/// scale texture coordinates by "v_texScale".
+	////////////////////////////////////////////////////////////////////////////////
+	struct ScreenPass {
+		ScreenPass();
+
+		//Set uniform value used by this pass
+		void setUniform(const char* name, GLint value);
+		void setUniform(const char* name, GLfloat x);
+		void setUniform(const char* name, GLfloat x, GLfloat y);
+		void setUniform(const char* name, GLfloat x, GLfloat y, GLfloat z);
+
+		QGLShaderProgram* shader;
+		QGLFramebufferObject* target; //Framebuffer to draw into (default framebuffer if zero)
+		GLuint textures[2]; //Textures bound to units 0 and 1
+		QSizeF textureScale; //Part of the textures which covers the screen
+		bool blend; //Blend over contents of the target
+
+		struct Uniform {
+			QByteArray name;
+			int components; //Number of float components (zero for integer uniform)
+			GLfloat value[3];
+			GLint integer;
+		};
+		QList<Uniform> uniforms;
+	};
+
+
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief List of full-screen passes drawn one after another.
+	///
+	/// All passes draw the same full-screen triangle from a vertex buffer. Render
+	/// state is set up once for the entire chain, framebuffers are only switched
+	/// when target changes between passes.
+	////////////////////////////////////////////////////////////////////////////////
+	class ScreenPassChain {
+	public:
+		//Add pass drawn with the shader into the target
+		ScreenPass& add(QGLShaderProgram* shader, QGLFramebufferObject* target);
+		//Draw all passes
+		void run();
+
+	private:
+		static QGLBuffer* getTriangleBuffer();
+		QList<ScreenPass> passes;
+	};
+}
+
+#endif
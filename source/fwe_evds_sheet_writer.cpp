@@ -0,0 +1,258 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#include <QDataStream>
+#include "fwe_evds_sheet_writer.h"
+
+using namespace EVDS;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Number of image rows in a single TIFF strip
+////////////////////////////////////////////////////////////////////////////////
+#define FWE_SHEET_ROWS_PER_STRIP	64
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Maximum number of tiles waiting to be written
+////////////////////////////////////////////////////////////////////////////////
+#define FWE_SHEET_QUEUE_LENGTH		4
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+SheetImageWriter::SheetImageWriter(const QString& in_filename, int in_width, int in_height, float in_ppcm) {
+	filename = in_filename;
+	width = in_width;
+	height = in_height;
+	ppcm = in_ppcm;
+	dataOffset = 0;
+	doFinish = false;
+	failed = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+SheetImageWriter::~SheetImageWriter() {
+	if (isRunning()) finish();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Create file, write header and start the worker thread
+////////////////////////////////////////////////////////////////////////////////
+bool SheetImageWriter::open() {
+	if ((width <= 0) || (height <= 0)) return false;
+
+	file.setFileName(filename);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+	if (!writeHeader()) {
+		file.close();
+		file.remove();
+		return false;
+	}
+
+	start();
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write TIFF header and image file directory.
+///
+/// Image is stored as uncompressed 8-bit RGB, so all strip offsets are known before
+/// any pixels are written.
+////////////////////////////////////////////////////////////////////////////////
+bool SheetImageWriter::writeHeader() {
+	quint32 strips = (height + FWE_SHEET_ROWS_PER_STRIP - 1) / FWE_SHEET_ROWS_PER_STRIP;
+	quint32 ifd_offset = 8;
+	quint32 ifd_entries = 12;
+	quint32 bps_offset = ifd_offset + 2 + ifd_entries*12 + 4;
+	quint32 xres_offset = bps_offset + 6;
+	quint32 yres_offset = xres_offset + 8;
+	quint32 strip_offsets_offset = yres_offset + 8;
+	quint32 strip_counts_offset = strip_offsets_offset + strips*4;
+	dataOffset = strip_counts_offset + strips*4;
+
+	//Classic TIFF can not address more than 4 GB
+	qint64 image_size = ((qint64)width)*((qint64)height)*3;
+	if (dataOffset + image_size >= Q_INT64_C(0xFFFFFFFF)) return false;
+
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::LittleEndian);
+
+	//Header
+	stream << (quint8)'I' << (quint8)'I' << (quint16)42 << ifd_offset;
+
+	//Image file directory (values smaller than 4 bytes are stored in place)
+	quint32 row_bytes = width*3;
+	quint32 last_strip_rows = height - (strips-1)*FWE_SHEET_ROWS_PER_STRIP;
+	stream << (quint16)ifd_entries;
+	stream << (quint16)256 << (quint16)4 << (quint32)1 << (quint32)width; //ImageWidth
+	stream << (quint16)257 << (quint16)4 << (quint32)1 << (quint32)height; //ImageLength
+	stream << (quint16)258 << (quint16)3 << (quint32)3 << bps_offset; //BitsPerSample
+	stream << (quint16)259 << (quint16)3 << (quint32)1 << (quint32)1; //Compression (none)
+	stream << (quint16)262 << (quint16)3 << (quint32)1 << (quint32)2; //PhotometricInterpretation (RGB)
+	if (strips == 1) {
+		stream << (quint16)273 << (quint16)4 << (quint32)1 << (quint32)dataOffset; //StripOffsets
+	} else {
+		stream << (quint16)273 << (quint16)4 << strips << strip_offsets_offset;
+	}
+	stream << (quint16)277 << (quint16)3 << (quint32)1 << (quint32)3; //SamplesPerPixel
+	stream << (quint16)278 << (quint16)4 << (quint32)1 << (quint32)FWE_SHEET_ROWS_PER_STRIP; //RowsPerStrip
+	if (strips == 1) {
+		stream << (quint16)279 << (quint16)4 << (quint32)1 << (quint32)(last_strip_rows*row_bytes); //StripByteCounts
+	} else {
+		stream << (quint16)279 << (quint16)4 << strips << strip_counts_offset;
+	}
+	stream << (quint16)282 << (quint16)5 << (quint32)1 << xres_offset; //XResolution
+	stream << (quint16)283 << (quint16)5 << (quint32)1 << yres_offset; //YResolution
+	stream << (quint16)296 << (quint16)3 << (quint32)1 << (quint32)3; //ResolutionUnit (centimeters)
+	stream << (quint32)0; //No more directories
+
+	//Values referenced from the directory
+	quint32 resolution = (quint32)(ppcm*100.0f + 0.5f);
+	stream << (quint16)8 << (quint16)8 << (quint16)8;
+	stream << resolution << (quint32)100;
+	stream << resolution << (quint32)100;
+	for (quint32 i = 0; i < strips; i++) {
+		stream << (quint32)(dataOffset + i*FWE_SHEET_ROWS_PER_STRIP*row_bytes);
+	}
+	for (quint32 i = 0; i < strips; i++) {
+		if (i == strips-1) {
+			stream << (quint32)(last_strip_rows*row_bytes);
+		} else {
+			stream << (quint32)(FWE_SHEET_ROWS_PER_STRIP*row_bytes);
+		}
+	}
+	if (stream.status() != QDataStream::Ok) return false;
+
+	//Reserve space for pixels, tiles may arrive in any order
+	if (!file.flush()) return false;
+	return file.resize(dataOffset + image_size);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Queue tile for writing. Blocks while the queue is full
+////////////////////////////////////////////////////////////////////////////////
+void SheetImageWriter::writeTile(int x, int y, const QImage& tile) {
+	Tile queued_tile;
+	queued_tile.x = x;
+	queued_tile.y = y;
+	queued_tile.image = tile;
+
+	queueLock.lock();
+	while (queue.count() >= FWE_SHEET_QUEUE_LENGTH) {
+		queueCondition.wait(&queueLock);
+	}
+	queue.append(queued_tile);
+	queueCondition.wakeAll();
+	queueLock.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Write all queued tiles and close file. Incomplete file is removed
+////////////////////////////////////////////////////////////////////////////////
+bool SheetImageWriter::finish() {
+	queueLock.lock();
+	doFinish = true;
+	queueCondition.wakeAll();
+	queueLock.unlock();
+	wait();
+
+	file.close();
+	if (failed || (file.error() != QFile::NoError)) {
+		file.remove();
+		return false;
+	}
+	return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Take tiles from the queue and write them until finished
+////////////////////////////////////////////////////////////////////////////////
+void SheetImageWriter::run() {
+	queueLock.lock();
+	while (true) {
+		while (queue.isEmpty() && (!doFinish)) {
+			queueCondition.wait(&queueLock);
+		}
+		if (queue.isEmpty()) break;
+
+		//Take tile and let interface thread queue the next one while this one is written
+		Tile tile = queue.takeFirst();
+		bool skip = failed;
+		queueCondition.wakeAll();
+		queueLock.unlock();
+
+		bool written = skip || writeTileRows(tile);
+
+		queueLock.lock();
+		if (!written) failed = true;
+	}
+	queueLock.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Convert rows of the tile into RGB and write them into their place in file
+////////////////////////////////////////////////////////////////////////////////
+bool SheetImageWriter::writeTileRows(const Tile& tile) {
+	if (tile.image.isNull()) return false;
+
+	QImage image = tile.image;
+	if ((image.format() != QImage::Format_RGB32) && (image.format() != QImage::Format_ARGB32)) {
+		image = image.convertToFormat(QImage::Format_RGB32);
+	}
+
+	//Part of the tile inside the image
+	int columns = qMin(image.width(), width - tile.x);
+	int rows = qMin(image.height(), height - tile.y);
+	if ((columns <= 0) || (rows <= 0)) return true;
+
+	QByteArray row_data(columns*3,0);
+	for (int y = 0; y < rows; y++) {
+		const QRgb* line = (const QRgb*)image.constScanLine(y);
+		char* rgb = row_data.data();
+		for (int x = 0; x < columns; x++) {
+			rgb[x*3+0] = (char)qRed(line[x]);
+			rgb[x*3+1] = (char)qGreen(line[x]);
+			rgb[x*3+2] = (char)qBlue(line[x]);
+		}
+
+		qint64 offset = dataOffset + (((qint64)(tile.y + y))*width + tile.x)*3;
+		if (!file.seek(offset)) return false;
+		if (file.write(row_data) != row_data.size()) return false;
+	}
+	return true;
+}
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @file
+////////////////////////////////////////////////////////////////////////////////
+/// Copyright (C) 2012-2013, Black Phoenix
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions are met:
+///   - Redistributions of source code must retain the above copyright
+///     notice, this list of conditions and the following disclaimer.
+///   - Redistributions in binary form must reproduce the above copyright
+///     notice, this list of conditions and the following disclaimer in the
+///     documentation and/or other materials provided with the distribution.
+///   - Neither the name of the author nor the names of the contributors may
+///     be used to endorse or promote products derived from this software without
+///     specific prior written permission.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+/// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+/// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+/// DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+/// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+/// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+/// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+/// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+/// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FWE_EVDS_SHEET_WRITER_H
+#define FWE_EVDS_SHEET_WRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QImage>
+#include <QList>
+
+namespace EVDS {
+	////////////////////////////////////////////////////////////////////////////////
+	/// @brief Writes a large image into an uncompressed striped TIFF file tile by tile.
+	///
+	/// Tiles are converted and written by a worker thread directly into their place in
+	/// the file, so the complete image is never kept in memory. Only a few tiles may
+	/// wait in the queue, interface thread is blocked while the queue is full.
+	////////////////////////////////////////////////////////////////////////////////
+	class SheetImageWriter : public QThread {
+	public:
+		SheetImageWriter(const QString& in_filename, int in_width, int in_height, float in_ppcm);
+		~SheetImageWriter();
+
+		//Create file, write header and start the worker thread
+		bool open();
+		//Queue tile for writing (parts outside of the image are ignored)
+		void writeTile(int x, int y, const QImage& tile);
+		//Write all queued tiles and close file. Returns false if writing has failed
+		bool finish();
+
+	protected:
+		void run();
+
+	private:
+		struct Tile {
+			int x;
+			int y;
+			QImage image;
+		};
+
+		//Write TIFF header and image file directory
+		bool writeHeader();
+		//Write rows of the tile into the file
+		bool writeTileRows(const Tile& tile);
+
+		QString filename;
+		int width;
+		int height;
+		float ppcm;
+		qint64 dataOffset; //Offset of the first pixel in file
+		QFile file;
+
+		QMutex queueLock;
+		QWaitCondition queueCondition; //Signalled when a tile is added or taken from the queue
+		QList<Tile> queue;
+		bool doFinish; //No more tiles will be added
+		bool failed; //Writing has failed
+	};
+}
+
+#endif
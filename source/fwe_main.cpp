@@ -62,6 +62,12 @@ MainWindow::MainWindow() {
 		fw_editor_settings->value("rendering.no_lods",				false));
 	fw_editor_settings->setValue ("rendering.use_fxaa",			
 		fw_editor_settings->value("rendering.use_fxaa",				true));
+	fw_editor_settings->setValue ("rendering.use_vbo",			
+		fw_editor_settings->value("rendering.use_vbo",				true));
+	fw_editor_settings->setValue ("rendering.shadow_blur_radius",	
+		fw_editor_settings->value("rendering.shadow_blur_radius",	8.0));
+	fw_editor_settings->setValue ("rendering.shadow_downsample",	
+		fw_editor_settings->value("rendering.shadow_downsample",	2));
 	fw_editor_settings->setValue ("rendering.outline_thickness",			
 		fw_editor_settings->value("rendering.outline_thickness",	1.0));
 	fw_editor_settings->setValue ("ui.autosave",					
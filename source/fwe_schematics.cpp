@@ -255,8 +255,10 @@ void SchematicsEditor::setModified() {
 ////////////////////////////////////////////////////////////////////////////////
 void SchematicsEditor::setEditorHidden(bool isHidden) {
 	if (isHidden) sheet = 0;
+	rendering_manager->invalidateReferences(); //Vessel may be modified while schematics are hidden
 	rendering_manager->updateInstances(); //Clear out all modifier-created instances to avoid crashes
 	if (!isHidden) { //Invalidate objects tree
+		glscene->invalidateOverlay(); //Document information may have been changed in the other editor
 		if (objectlist_model) {
 			delete objectlist_model;
 			
@@ -327,7 +329,7 @@ void SchematicsEditor::selectObject(const QModelIndex& index) {
 
 	//Get currently selected schematics sheet
 	sheet = object;
-	while (sheet && (sheet->getType() != "foxworks.schematics.sheet")) {
+	while (sheet && (sheet->getTypeID() != Object::TYPE_SCHEMATICS_SHEET)) {
 		sheet = sheet->getParent();
 		if (sheet == root) sheet = NULL;
 	}
@@ -356,6 +358,8 @@ void SchematicsEditor::updateObject(Object* object) {
 		list_model->updateObject(object);
 	}
 	//rendering_manager->updateInstances();
+	glscene->invalidateFrame();
+	glscene->invalidateOverlay();
 	glscene->update();
 }
 
@@ -389,7 +393,7 @@ void SchematicsEditor::initializeForFile() {
 	Object* document = editor->getEditDocument();
 	root = NULL;
 	for (int i = 0; i < document->getChildrenCount(); i++) {
-		if (document->getChild(i)->getType() == "foxworks.schematics") {
+		if (document->getChild(i)->getTypeID() == Object::TYPE_SCHEMATICS) {
 			root = document->getChild(i);
 			break;
 		}
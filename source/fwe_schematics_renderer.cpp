@@ -37,11 +37,20 @@
 using namespace EVDS;
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Names of schematics element variables
+////////////////////////////////////////////////////////////////////////////////
+static const VariableName var_reference("reference");
+static const VariableName var_scale("scale");
+static const VariableName var_sheet_scale("sheet.scale");
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 SchematicsRenderingManager::SchematicsRenderingManager(SchematicsEditor* in_editor) {
 	schematics_editor = in_editor;
+	sheetScale = 1.0;
 }
 
 
@@ -62,31 +71,36 @@ SchematicsRenderingManager::~SchematicsRenderingManager() {
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// @brief
+/// @brief Update instances for the current sheet.
+///
+/// Only elements which were added, removed or changed their reference get their
+/// instances re-created. Positions are updated for all instances.
 ////////////////////////////////////////////////////////////////////////////////
 void SchematicsRenderingManager::updateInstances() {
 	GLScene* glview = schematics_editor->getGLScene();
 
-	qDebug("SchematicsRenderingManager::updateInstances()");
-
-	//Remove all instances from glview
-	for (int i = 0; i < schematicsInstances.count(); i++) {
-		if (glview->getCollection()->contains(schematicsInstances[i].instance->id())) {
-			glview->getCollection()->remove(schematicsInstances[i].instance->id());
-		}
-		delete schematicsInstances[i].instance;
-	}
-	schematicsInstances.clear();
-
 	//Process all object starting from root
+	QSet<Object*> present;
 	if (schematics_editor->getCurrentSheet()) {
-		processUpdateInstances(schematics_editor->getCurrentSheet());
+		processUpdateInstances(schematics_editor->getCurrentSheet(),&present);
+	}
+
+	//Remove instances of elements which are no longer on the sheet
+	QHash<Object*,SchematicsElementInstances>::iterator i = elementInstances.begin();
+	while (i != elementInstances.end()) {
+		if (!present.contains(i.key())) {
+			removeInstances(&i.value());
+			i = elementInstances.erase(i);
+		} else {
+			++i;
+		}
 	}
 
 	//Set position
 	updatePositions();
 
 	//Update GL scene
+	glview->invalidateGeometry();
 	glview->update();
 }
 
@@ -95,55 +109,108 @@ void SchematicsRenderingManager::updateInstances() {
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 void SchematicsRenderingManager::updatePositions() {
-	//Set positions of all children
-	for (int i = 0; i < schematicsInstances.count(); i++) {
-		setInstancePosition(&schematicsInstances[i]);
+	//Base instances must be in their final positions
+	schematics_editor->getEVDSEditor()->updateTransformations();
+
+	//Default scale for elements
+	sheetScale = 1.0;
+	if (schematics_editor->getCurrentSheet()) {
+		sheetScale = schematics_editor->getCurrentSheet()->getVariable(var_sheet_scale);
+		if (sheetScale <= 0.0) sheetScale = 1.0;
 	}
+
+	//Set positions of all children (each element transformation is computed once)
+	QHash<Object*,SchematicsElementInstances>::iterator i;
+	for (i = elementInstances.begin(); i != elementInstances.end(); ++i) {
+		for (int j = 0; j < i.value().instances.count(); j++) {
+			setInstancePosition(&i.value().instances[j]);
+		}
+	}
+	elementTransformations.clear();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Forget all resolved references and instances created from them
+////////////////////////////////////////////////////////////////////////////////
+void SchematicsRenderingManager::invalidateReferences() {
+	resolvedReferences.clear();
+
+	QHash<Object*,SchematicsElementInstances>::iterator i;
+	for (i = elementInstances.begin(); i != elementInstances.end(); ++i) {
+		removeInstances(&i.value());
+	}
+	elementInstances.clear();
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void SchematicsRenderingManager::processUpdateInstances(Object* element) {
+void SchematicsRenderingManager::processUpdateInstances(Object* element, QSet<Object*>* present) {
 	//Process all children first
 	for (int i = 0; i < element->getChildrenCount(); i++) {
-		processUpdateInstances(element->getChild(i));
+		processUpdateInstances(element->getChild(i),present);
 	}
 
 	//Create instances for object elements
-	if (element->getType() == "foxworks.schematics.element") {
-		EVDS_OBJECT* evds_object = 0;
-		QString reference = element->getString("reference");
-
-		if (reference != "") {
-			EVDS_SYSTEM* system;
-			EVDS_Object_GetSystem(element->getEVDSObject(),&system);
-			EVDS_System_QueryByReference(schematics_editor->getEVDSEditor()->getEditRoot()->getEVDSObject(),
-				reference.toAscii().data(),0,&evds_object);
-
-			if (evds_object) {
-				Object* object;
-				EVDS_Object_GetUserdata(evds_object,(void**)&object);
-				if (object != schematics_editor->getEVDSEditor()->getEditRoot()) {
-					createInstance(element,object,true);
-				}
-			}
+	if (element->getTypeID() == Object::TYPE_SCHEMATICS_ELEMENT) {
+		present->insert(element);
+
+		//Keep instances if element still refers to the same object
+		QString reference = element->getString(var_reference);
+		Object* object = resolveReference(reference);
+		QHash<Object*,SchematicsElementInstances>::iterator i = elementInstances.find(element);
+		if (i != elementInstances.end()) {
+			if ((i.value().reference == reference) && (i.value().object == object)) return;
+			removeInstances(&i.value());
+		}
+
+		//Create new instances
+		SchematicsElementInstances& element_instances = elementInstances[element];
+		element_instances.reference = reference;
+		element_instances.object = object;
+		if (object && (object != schematics_editor->getEVDSEditor()->getEditRoot())) {
+			createInstance(&element_instances,element,object,true);
 		}
 	}
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+Object* SchematicsRenderingManager::resolveReference(const QString& reference) {
+	if (reference == "") return 0;
+
+	QHash<QString,Object*>::iterator i = resolvedReferences.find(reference);
+	if (i != resolvedReferences.end()) return i.value();
+
+	EVDS_OBJECT* evds_object = 0;
+	Object* object = 0;
+	EVDS_System_QueryByReference(schematics_editor->getEVDSEditor()->getEditRoot()->getEVDSObject(),
+		reference.toAscii().data(),0,&evds_object);
+	if (evds_object) {
+		EVDS_Object_GetUserdata(evds_object,(void**)&object);
+	}
+	resolvedReferences[reference] = object;
+	return object;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
 GLC_Matrix4x4 SchematicsRenderingManager::getTransformationMatrix(Object* element) {
+	//Parent elements are shared by many instances
+	QHash<Object*,GLC_Matrix4x4>::iterator i = elementTransformations.find(element);
+	if (i != elementTransformations.end()) return i.value();
+
 	//Calculate scale
-	double scale = element->getVariable("scale");
+	double scale = element->getVariable(var_scale);
 	if (scale <= 0.0) {
 		//if (firstRecursive) { //Use default scale for firstmost object
-			scale = schematics_editor->getCurrentSheet()->getVariable("sheet.scale");
-			if (scale <= 0.0) scale = 1.0;
+			scale = sheetScale;
 		//} else { //No scaling change
 			//scale = 1.0;
 		//}
@@ -162,11 +229,12 @@ GLC_Matrix4x4 SchematicsRenderingManager::getTransformationMatrix(Object* elemen
 
 	transformation = transformation*GLC_Matrix4x4(vector.position.x,vector.position.y,vector.position.z);
 	transformation = transformation*GLC_Matrix4x4(rotationMatrix);
-	if (element->getParent() && (element->getParent()->getType() != "foxworks.schematics.sheet")) {
+	if (element->getParent() && (element->getParent()->getTypeID() != Object::TYPE_SCHEMATICS_SHEET)) {
 		transformation = transformation*getTransformationMatrix(element->getParent());
 	} else {
 		transformation = transformation*scaling; //First operation is scaling
 	}
+	elementTransformations[element] = transformation;
 	return transformation;
 }
 
@@ -186,19 +254,31 @@ void SchematicsRenderingManager::setInstancePosition(SchematicsObjectInstance* s
 		schematics_instance->instance->setVisibility(schematics_instance->base_instance->isVisible());
 	}
 
-	//Add/replace to update position
+	//Update position of the instance stored in GL widget
+	schematics_editor->getGLScene()->updateInstance(*schematics_instance->instance);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief
+////////////////////////////////////////////////////////////////////////////////
+void SchematicsRenderingManager::removeInstances(SchematicsElementInstances* element_instances) {
 	GLScene* glview = schematics_editor->getGLScene();
-	if (glview->getCollection()->contains(schematics_instance->instance->id())) {
-		glview->getCollection()->remove(schematics_instance->instance->id());
+	for (int i = 0; i < element_instances->instances.count(); i++) {
+		GLC_3DViewInstance* instance = element_instances->instances[i].instance;
+		if (glview->getCollection()->contains(instance->id())) {
+			glview->getCollection()->remove(instance->id());
+		}
+		delete instance;
 	}
-	glview->getCollection()->add(*schematics_instance->instance);
+	element_instances->instances.clear();
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief
 ////////////////////////////////////////////////////////////////////////////////
-void SchematicsRenderingManager::createInstance(Object* element, Object* object, bool resetVisibility) {
+void SchematicsRenderingManager::createInstance(SchematicsElementInstances* element_instances, Object* element, Object* object, bool resetVisibility) {
 	//Create instance
 	SchematicsObjectInstance schematics_instance;
 	schematics_instance.base_instance = object->getRenderer()->getInstance();
@@ -210,7 +290,7 @@ void SchematicsRenderingManager::createInstance(Object* element, Object* object,
 	//Add instance to scene
 	schematics_editor->getGLScene()->getCollection()->add(*schematics_instance.instance);
 	//Append instance
-	schematicsInstances.append(schematics_instance);
+	element_instances->instances.append(schematics_instance);
 
 
 	//Create instances for modifiers of this object
@@ -227,13 +307,13 @@ void SchematicsRenderingManager::createInstance(Object* element, Object* object,
 		//Add instance to scene
 		schematics_editor->getGLScene()->getCollection()->add(*schematics_instance.instance);
 		//Append instance
-		schematicsInstances.append(schematics_instance);
+		element_instances->instances.append(schematics_instance);
 	}
 
 
 	//Create instances for children
 	for (int i = 0; i < object->getChildrenCount(); i++) {
-		createInstance(element,object->getChild(i),resetVisibility);
+		createInstance(element_instances,element,object->getChild(i),resetVisibility);
 	}
 		
 	//if ((object->getType() == "modifier") && (object != modifier)) {
@@ -30,6 +30,8 @@
 #define FWE_SCHEMATICS_RENDERER_H
 
 #include <QThread>
+#include <QHash>
+#include <QSet>
 
 #include <GLC_Mesh>
 #include <GLC_3DViewInstance>
@@ -46,6 +48,11 @@ namespace EVDS {
 		Object* element; //Element that created this instance
 		bool resetVisibility;
 	};
+	struct SchematicsElementInstances {
+		QString reference; //Reference from which instances were created
+		Object* object; //Object found by the reference
+		QList<SchematicsObjectInstance> instances; //Instances of the object and its children
+	};
 	class SchematicsRenderingManager : public QObject
 	{
 		Q_OBJECT
@@ -54,24 +61,35 @@ namespace EVDS {
 		SchematicsRenderingManager(SchematicsEditor* in_editor);
 		~SchematicsRenderingManager();
 
-		//Re-create instances
+		//Re-create instances of elements which were added, removed or changed their reference
 		void updateInstances();
 		//Re-position instances
 		void updatePositions();
+		//Hierarchy of the referenced objects was changed, all instances must be re-created
+		void invalidateReferences();
 
 	private:
 		//Find all elements and update instances for them
-		void processUpdateInstances(Object* element);
+		void processUpdateInstances(Object* element, QSet<Object*>* present);
+		//Find object by reference (results are cached until hierarchy changes)
+		Object* resolveReference(const QString& reference);
 		//Create instance given element description and target object
-		void createInstance(Object* element, Object* object, bool resetVisibility);
+		void createInstance(SchematicsElementInstances* element_instances, Object* element, Object* object, bool resetVisibility);
+		//Remove instances from the scene and delete them
+		void removeInstances(SchematicsElementInstances* element_instances);
 		//Sets position of the modified instance
 		void setInstancePosition(SchematicsObjectInstance* schematics_instance);
 
-		//Get transformation matrix for element
+		//Get transformation matrix for element (cached during a single update of positions)
 		GLC_Matrix4x4 getTransformationMatrix(Object* element);
 
-		//Instances created for schematics
-		QList<SchematicsObjectInstance> schematicsInstances;
+		//Instances created for schematics (for every element of the current sheet)
+		QHash<Object*,SchematicsElementInstances> elementInstances;
+		//Objects found by reference
+		QHash<QString,Object*> resolvedReferences;
+		//Transformations of elements computed during current update of positions
+		QHash<Object*,GLC_Matrix4x4> elementTransformations;
+		double sheetScale;
 
 		//Schematics editor
 		SchematicsEditor* schematics_editor;